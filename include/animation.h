@@ -0,0 +1,66 @@
+#pragma once
+
+#include "geometry.h"
+
+#include <vector>
+
+class Camera;
+class Instance;
+class PrimitiveManager;
+
+/**
+ * Keyframes of the camera and of instance transformations. Time is measured
+ * in frames. Between keyframes the eye orbits the target, rotations are
+ * interpolated spherically and the rest linearly. Before the first and after
+ * the last keyframe the values are held.
+ */
+class Animation {
+public: /* Types: */
+
+    struct CameraKey {
+        floating time;
+        Point    from;
+        Point    at;
+        Vector   up;
+        floating fov;
+    };
+
+    struct InstanceKey {
+        floating time;
+        Matrix   toWorld;
+    };
+
+    /// Keyframes of a single instance.
+    struct Track {
+        Instance*                instance;
+        std::vector<InstanceKey> keys;
+    };
+
+public: /* Methods: */
+
+    bool empty() const { return m_cameraKeys.empty() && m_tracks.empty(); }
+
+    void clear() {
+        m_cameraKeys.clear();
+        m_tracks.clear();
+    }
+
+    void addCameraKey(const CameraKey& key);
+
+    /// Keyframes of an instance must be added one after another.
+    void addInstanceKey(Instance* instance, const InstanceKey& key);
+
+    const std::vector<CameraKey>& cameraKeys() const { return m_cameraKeys; }
+    const std::vector<Track>& tracks() const { return m_tracks; }
+
+    /**
+     * Poses the camera and the instances at @a time and refits @a manager to
+     * the instances whose transformation changed, instances that stay put
+     * are not touched. Must not be called while rendering.
+     */
+    void apply(floating time, Camera& camera, PrimitiveManager& manager) const;
+
+private: /* Fields: */
+    std::vector<CameraKey> m_cameraKeys; ///< Sorted by time.
+    std::vector<Track>     m_tracks;     ///< Keys are sorted by time.
+};
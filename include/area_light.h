@@ -22,8 +22,9 @@ public: /* Methods: */
         m_invArea = 1.0 / len;
     }
 
-    IlluminateResult illuminate(Point pos) const override {
-        const auto pointOnRectangle = m_point + rng() * m_u + rng() * m_v;
+    IlluminateResult illuminate(Point pos, Sampler& sampler) const override {
+        const auto u = sampler.get2D();
+        const auto pointOnRectangle = m_point + u.x * m_u + u.y * m_v;
         auto       direction = pointOnRectangle - pos;
         const auto distSqr = direction.sqrlength();
         const auto distance = std::sqrt(distSqr);
@@ -39,16 +40,17 @@ public: /* Methods: */
                 directPdfW,  emissionPdfW, cosNormal};
     }
 
-    EmitResult emit() const override {
-        const auto sample = sampleCosHemisphere();
-        const auto localDir = sample.get();
+    EmitResult emit(Sampler& sampler) const override {
+        auto localDir = sampleCosHemisphere(sampler).get();
+        while (localDir.z < epsilon) // try again if angle is too steep
+            localDir = sampleCosHemisphere(sampler).get();
+
         const auto cosTheta = localDir.z;
-        if (cosTheta < epsilon) // try again if angle is too steep
-            return emit();
 
-        const auto pointOnRectangle = m_point + rng() * m_u + rng() * m_v;
+        const auto u = sampler.get2D();
+        const auto pointOnRectangle = m_point + u.x * m_u + u.y * m_v;
         const auto direction = m_frame.toWorld(localDir);
-        const auto emissionPdfW = m_invArea * sample.pdfW();
+        const auto emissionPdfW = m_invArea * localCosHemispherePdfW(localDir);
         const auto directPdfA = m_invArea;
         return {cosTheta * intensity(),
                 pointOnRectangle,
@@ -67,6 +69,17 @@ public: /* Methods: */
         return {intensity(), m_invArea * cosNormal * RAY_INV_PI, m_invArea};
     }
 
+    floating power() const override {
+        return luminance(intensity()) * RAY_PI / m_invArea;
+    }
+
+    void write(BinaryWriter& out) const override {
+        writeHeader(out, LightType::Area);
+        out.writeVector(m_point);
+        out.writeVector(m_u);
+        out.writeVector(m_v);
+    }
+
 private: /* Fields: */
     const Point  m_point;
     const Vector m_u;
@@ -10,8 +10,8 @@ public: /* Methods: */
         : Light{sceneSphere, intensity, false, false}
     {}
 
-    IlluminateResult illuminate(Point) const override {
-        const auto sample = sampleUniformSphere();
+    IlluminateResult illuminate(Point, Sampler& sampler) const override {
+        const auto sample = sampleUniformSphere(sampler);
         const auto direction = sample.get();
         const auto directPdfW = sample.pdfW();
         const auto emissionPdfW =
@@ -21,14 +21,14 @@ public: /* Methods: */
                 directPdfW,  emissionPdfW, 1.0};
     }
 
-    EmitResult emit() const override {
+    EmitResult emit(Sampler& sampler) const override {
         // Sample direction:
-        const auto dirSample = sampleUniformSphere();
+        const auto dirSample = sampleUniformSphere(sampler);
         const auto direction = dirSample.get();
 
         // Sample position:
         const auto frame = Frame{direction};
-        const auto discSample = sampleConcentricDisc();
+        const auto discSample = sampleConcentricDisc(sampler);
         const auto offset =
             sceneSphere().center() + sceneSphere().radius() * (-direction);
         const auto x = discSample.get().x;
@@ -53,4 +53,13 @@ public: /* Methods: */
         const auto emissionPdfW = directPdf * positionPdf;
         return {intensity(), emissionPdfW, directPdf};
     }
+
+    floating power() const override {
+        return luminance(intensity()) * 4.0 * RAY_PI * RAY_PI /
+               sceneSphere().invRadiusSqr();
+    }
+
+    void write(BinaryWriter& out) const override {
+        writeHeader(out, LightType::Background);
+    }
 };
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "geometry.h"
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Appends values in native byte order to a memory buffer. Used for the binary
+ * scene cache, which is only ever read back on the same machine.
+ */
+class BinaryWriter {
+public: /* Methods: */
+
+    template <typename T>
+    void write(T value) {
+        static_assert(std::is_arithmetic<T>::value,
+                      "Only arithmetic values can be written.");
+        const auto bytes = reinterpret_cast<const char*>(&value);
+        m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    void writeVector(const Vector& v) {
+        write<floating>(v.x);
+        write<floating>(v.y);
+        write<floating>(v.z);
+    }
+
+    void writeString(const std::string& s) {
+        write<uint32_t>(s.size());
+        m_buffer.insert(m_buffer.end(), s.begin(), s.end());
+    }
+
+    const std::vector<char>& buffer() const { return m_buffer; }
+
+private: /* Fields: */
+    std::vector<char> m_buffer;
+};
+
+/**
+ * Reads values written by BinaryWriter from a memory buffer. Reading past the
+ * end of the buffer yields zeroes and marks the reader as failed.
+ */
+class BinaryReader {
+public: /* Methods: */
+
+    BinaryReader(const char* begin, const char* end)
+        : m_cur{begin}
+        , m_end{end}
+        , m_ok{true}
+    {}
+
+    bool ok() const { return m_ok; }
+
+    size_t remaining() const { return m_end - m_cur; }
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_arithmetic<T>::value,
+                      "Only arithmetic values can be read.");
+        T value{};
+        if (remaining() < sizeof(T)) {
+            m_ok = false;
+            m_cur = m_end;
+            return value;
+        }
+
+        memcpy(&value, m_cur, sizeof(T));
+        m_cur += sizeof(T);
+        return value;
+    }
+
+    Vector readVector() {
+        const auto x = read<floating>();
+        const auto y = read<floating>();
+        const auto z = read<floating>();
+        return Vector{x, y, z};
+    }
+
+    Point readPoint() {
+        const auto v = readVector();
+        return Point{v.x, v.y, v.z};
+    }
+
+    Colour readColour() {
+        const auto v = readVector();
+        return Colour{v.x, v.y, v.z};
+    }
+
+    std::string readString() {
+        const auto size = read<uint32_t>();
+        if (remaining() < size) {
+            m_ok = false;
+            m_cur = m_end;
+            return std::string{};
+        }
+
+        const std::string s{m_cur, m_cur + size};
+        m_cur += size;
+        return s;
+    }
+
+private: /* Fields: */
+    const char*       m_cur;
+    const char* const m_end;
+    bool              m_ok;
+};
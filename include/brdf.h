@@ -139,10 +139,15 @@ public: /* Methods: */
         return {dirPdfW, revPdfW};
     }
 
-    SampleResult sampleLight() const { return sample(true); }
-    SampleResult sampleCamera() const { return sample(false); }
+    SampleResult sampleLight(Sampler& sampler) const {
+        return sample(true, sampler);
+    }
+
+    SampleResult sampleCamera(Sampler& sampler) const {
+        return sample(false, sampler);
+    }
 
-    SampleResult sample(bool lightTracing) const {
+    SampleResult sample(bool lightTracing, Sampler& sampler) const {
         auto col = Colour{0, 0, 0};
         auto dir = Vector{0, 0, 0};
         auto pdfW = floating{0};
@@ -150,10 +155,10 @@ public: /* Methods: */
         auto event = NONE;
 
         {
-            const auto r = rng();
+            const auto r = sampler.get1D();
             if (r < m_diffPr) {
                 event = DIFFUSE;
-                sampleDiffuse(col, dir, pdfW);
+                sampleDiffuse(sampler, col, dir, pdfW);
             } else if (r < m_diffPr + m_reflPr) {
                 event = REFLECT;
                 sampleReflect(col, dir, pdfW);
@@ -197,12 +202,13 @@ private: /* Methods: */
         revPdfW += m_diffPr * fmax(0.0, m_localDirFix.z * RAY_INV_PI);
     }
 
-    void sampleDiffuse(Colour& result, Vector& dir, floating& pdfW) const {
+    void sampleDiffuse(Sampler& sampler, Colour& result, Vector& dir,
+                       floating& pdfW) const {
         if (m_localDirFix.z < epsilon)
             return;
 
         result += m_mat.colour() * m_mat.kd() * RAY_INV_PI;
-        const auto sample = sampleCosHemisphere();
+        const auto sample = sampleCosHemisphere(sampler);
         dir = sample.get();
         pdfW += m_diffPr * sample.pdfW();
     }
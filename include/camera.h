@@ -4,13 +4,38 @@
 #include "geometry.h"
 #include "ray.h"
 
-/// A camera.
+class Sampler;
+
+/**
+ * A camera, either a pinhole or a thin lens. Directions to the pixels are
+ * precomputed as a corner and deltas per pixel, so spawning a primary ray
+ * takes a few multiply-adds and a normalisation.
+ */
 class Camera {
+public: /* Types: */
+
+    /// Arguments of the setup call.
+    struct Parameters {
+        Point    from;
+        Point    at;
+        Vector   up;
+        floating fov;
+        floating hither;
+        size_t   width;
+        size_t   height;
+        floating aperture = 0.0; ///< Radius of the lens, zero for a pinhole.
+        floating focus = 0.0; ///< Distance in focus, zero for the target.
+    };
+
 public: /* Methods: */
-    void setup(Point from, Point at, Vector up, floating fov, floating hither,
-               size_t width, size_t height);
+    void setup(const Parameters& params);
 
-    Ray spawnRay(floating x, floating y) const;
+    /// Ray through the screen point, the point on the lens is taken from
+    /// @a sampler if the camera has an aperture.
+    Ray spawnRay(floating x, floating y, Sampler& sampler) const;
+
+    /// Point on the lens taken from @a sampler, the eye for a pinhole.
+    Point sampleLens(Sampler& sampler) const;
 
     size_t height() const { return m_height; }
     size_t width() const { return m_width; }
@@ -22,11 +47,25 @@ public: /* Methods: */
 
     bool raster(Point worldPoint, floating& x, floating& y) const;
 
+    /// Screen point of the ray from @a lensPoint through @a worldPoint.
+    bool raster(Point worldPoint, Point lensPoint, floating& x,
+                floating& y) const;
+
+    const Parameters& parameters() const { return m_parameters; }
+
 private: /* Fields: */
+    Parameters m_parameters; ///< Camera is set up from these.
     size_t   m_height;  ///< Screen height in pixels.
     size_t   m_width;   ///< Screen width in pixels.
     Point    m_eye;     ///< Position of camera eye.
     Vector   m_forward; ///< (Unitary) direction the camera is looking at.
+    Vector   m_right;   ///< (Unitary) screen x-axis.
+    Vector   m_down;    ///< (Unitary) screen y-axis.
+    Vector   m_corner;  ///< Direction to screen point (0, 0).
+    Vector   m_dx;      ///< Change of direction per pixel along x.
+    Vector   m_dy;      ///< Change of direction per pixel along y.
+    floating m_lensRadius;
+    floating m_focusDistance; ///< Along the forward direction.
     floating m_imagePlaneDistance; ///< Distance from eye to image plane.
     Matrix   m_toScreen; ///< Model-view projection matrix.
     Matrix   m_fromScreen; ///< Matrix to project screen-coordinates to world.
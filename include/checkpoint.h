@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Framebuffer;
+class Surface;
+
+/**
+ * Raw sums of a render that can be continued: the splats and the sample
+ * statistics of the even and the odd passes and the number of passes that
+ * are in them. Samples only depend on the pixel, the pass and the seed, so
+ * nothing else needs to be saved to render the following passes. Only
+ * deterministic renders continue bit for bit, as VCM then traces the merging
+ * vertices of the previous pass again. Otherwise VCM merges with the last
+ * pass of the same thread, so the continued image agrees with an
+ * uninterrupted one only up to noise.
+ *
+ * A render can be split into shards that take every shards-th pass starting
+ * from their index. Sums of the shards are simply added up.
+ *
+ * The file is tagged with a description of the job, which must name
+ * everything that the image depends on, and is only loaded back by the same
+ * job. Files are in native byte order.
+ */
+class Checkpoint {
+public: /* Methods: */
+
+    Checkpoint(std::string fname, std::string job, size_t shard = 0,
+               size_t shards = 1)
+        : m_fname{std::move(fname)}
+        , m_job{std::move(job)}
+        , m_shard{shard}
+        , m_shards{shards}
+    {}
+
+    const std::string& fileName() const { return m_fname; }
+
+    bool save(const Framebuffer (&halves)[2], const size_t (&counts)[2]) const;
+
+    /**
+     * Loads the sums into the framebuffers, which must have the dimensions
+     * of the saved ones.
+     * @retval false if the file is missing, damaged or of another job or
+     * shard.
+     */
+    bool load(Framebuffer (&halves)[2], size_t (&counts)[2]) const;
+
+    /// Adds the sums to the framebuffers like load.
+    bool add(Framebuffer (&halves)[2], size_t (&counts)[2]) const;
+
+private: /* Methods: */
+    bool read(Framebuffer (&halves)[2], size_t (&counts)[2], bool add) const;
+
+private: /* Fields: */
+    const std::string m_fname;
+    const std::string m_job;
+    const size_t      m_shard;
+    const size_t      m_shards;
+};
+
+/**
+ * Adds up the checkpoints of every shard of a render and writes the image to
+ * @a surfaces. Reasons of failure are printed to the standard error.
+ */
+bool mergeShards(const std::vector<std::string>& files,
+                 const std::vector<std::unique_ptr<Surface>>& surfaces);
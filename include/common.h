@@ -68,6 +68,22 @@ constexpr std::size_t RAY_MAX_REC_DEPTH = 5;
  */
 constexpr floating RAY_MIN_COLOUR_TOLERANCE = 0.000001;
 
+/**
+ * Default path length after which paths are subject to Russian roulette.
+ */
+constexpr std::size_t RAY_RR_START_DEPTH = 3;
+
+/**
+ * Default lower bound of Russian roulette survival probability.
+ */
+constexpr floating RAY_RR_MIN_SURVIVAL_PR = 0.05;
+
+/**
+ * Approximate size of the chunks that the NFF and OBJ readers split scene
+ * files into for parallel parsing.
+ */
+constexpr std::size_t RAY_PARSE_CHUNK_SIZE = 4 << 20;
+
 /**
  * Check compiler versions if we have thread_local keyword.
  */
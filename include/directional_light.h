@@ -14,7 +14,7 @@ public: /* Methods: */
         , m_frame{direction}
     {}
 
-    IlluminateResult illuminate(Point) const override {
+    IlluminateResult illuminate(Point, Sampler&) const override {
         const auto emissionPdfW =
             concentricDiscPdfA() * sceneSphere().invRadiusSqr();
         return {intensity(),
@@ -25,8 +25,8 @@ public: /* Methods: */
                 1.0};
     }
 
-    EmitResult emit() const override {
-        const auto sample = sampleConcentricDisc();
+    EmitResult emit(Sampler& sampler) const override {
+        const auto sample = sampleConcentricDisc(sampler);
         const auto x = sample.get().x;
         const auto y = sample.get().y;
         const auto position = getPoint(x, y);
@@ -40,6 +40,15 @@ public: /* Methods: */
         return {Colour{0, 0, 0}, 0.0, 0.0};
     }
 
+    floating power() const override {
+        return luminance(intensity()) * RAY_PI / sceneSphere().invRadiusSqr();
+    }
+
+    void write(BinaryWriter& out) const override {
+        writeHeader(out, LightType::Directional);
+        out.writeVector(m_frame.normal());
+    }
+
 private: /* Methods: */
 
     Point getPoint(floating x, floating y) const {
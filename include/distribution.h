@@ -0,0 +1,130 @@
+#pragma once
+
+#include "common.h"
+#include "geometry.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Discrete distribution that can be sampled in constant time.
+ * Uses Vose's variant of Walker's alias method. Every bin stores the
+ * probability of its own element, the threshold for keeping it and the
+ * index of the alias element.
+ */
+class AliasTable {
+private: /* Types: */
+
+    struct Bin {
+        float    pr;        ///< Probability of the element of this bin.
+        float    threshold; ///< Keep the element if below the threshold.
+        uint32_t alias;     ///< Element to pick otherwise.
+    };
+
+public: /* Methods: */
+
+    AliasTable() {}
+
+    /// Weights need not be normalised. If all are zero distribution is uniform.
+    explicit AliasTable(const std::vector<floating>& weights) {
+        build(weights);
+    }
+
+    void build(const std::vector<floating>& weights);
+
+    size_t size() const { return m_bins.size(); }
+
+    bool empty() const { return m_bins.empty(); }
+
+    /// Probability of picking the element @a i.
+    floating pr(size_t i) const { return m_bins[i].pr; }
+
+    /// Maps uniformly distributed @a u from [0, 1) to an element.
+    size_t sample(floating u) const {
+        const auto scaled = u * m_bins.size();
+        const auto i = std::min((size_t)scaled, m_bins.size() - 1);
+        return scaled - i < m_bins[i].threshold ? i : m_bins[i].alias;
+    }
+
+private: /* Fields: */
+    std::vector<Bin> m_bins;
+};
+
+/**
+ * Piecewise constant distribution over [0, 1) with the given number of equally
+ * sized pieces. The function values and CDF are kept in single precision and
+ * sampling inverts the CDF by binary search.
+ */
+class Distribution1D {
+public: /* Methods: */
+
+    Distribution1D() : m_integral{0} {}
+
+    /// Function values need not be normalised. If all are zero distribution
+    /// is uniform.
+    Distribution1D(const floating* func, size_t n) { build(func, n); }
+
+    void build(const floating* func, size_t n);
+
+    size_t size() const { return m_func.size(); }
+
+    /// Integral of the function over [0, 1), one if the function is zero.
+    floating integral() const { return m_integral; }
+
+    /// Density of the piece @a i with respect to [0, 1).
+    floating pdf(size_t i) const { return m_func[i] / m_integral; }
+
+    /**
+     * Maps uniformly distributed @a u from [0, 1) to [0, 1).
+     * @param pdf Density of the returned value.
+     * @param offset Index of the piece the value is in.
+     */
+    floating sample(floating u, floating& pdf, size_t& offset) const;
+
+private: /* Fields: */
+    std::vector<float> m_func;
+    std::vector<float> m_cdf;
+    floating           m_integral;
+};
+
+/**
+ * Piecewise constant distribution over [0, 1)^2 of a function given as
+ * row-major table of @a nv rows with @a nu values each. The row is picked from
+ * the marginal distribution and the column from the conditional distribution
+ * of that row.
+ */
+class Distribution2D {
+public: /* Methods: */
+
+    Distribution2D() {}
+
+    Distribution2D(const floating* func, size_t nu, size_t nv) {
+        build(func, nu, nv);
+    }
+
+    void build(const floating* func, size_t nu, size_t nv);
+
+    /// Maps uniform (u0, u1) to a point of [0, 1)^2 distributed like function.
+    Vector2 sample(floating u0, floating u1, floating& pdf) const {
+        floating pdfs[2];
+        size_t   u, v;
+        const auto d1 = m_marginal.sample(u1, pdfs[1], v);
+        const auto d0 = m_conditional[v].sample(u0, pdfs[0], u);
+        pdf = pdfs[0] * pdfs[1];
+        return Vector2{d0, d1};
+    }
+
+    /// Density of the point @a p of [0, 1)^2.
+    floating pdf(Vector2 p) const {
+        const auto nu = m_conditional[0].size();
+        const auto nv = m_marginal.size();
+        const auto iu = std::min((size_t)(p.x * nu), nu - 1);
+        const auto iv = std::min((size_t)(p.y * nv), nv - 1);
+        return m_conditional[iv].pdf(iu) * m_marginal.pdf(iv);
+    }
+
+private: /* Fields: */
+    std::vector<Distribution1D> m_conditional;
+    Distribution1D              m_marginal;
+};
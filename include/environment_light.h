@@ -0,0 +1,160 @@
+#pragma once
+
+#include "distribution.h"
+#include "light.h"
+#include "random.h"
+#include "texture.h"
+
+#include <vector>
+
+/**
+ * Infinitely far away light given by an equirectangular radiance map. Texture
+ * coordinate u follows the azimuth around the y axis and v the elevation:
+ * like image files the map is stored bottom row first so v = 0 is straight
+ * down and v = 1 straight up. Directions are importance sampled by luminance
+ * of the map using a piecewise constant 2D distribution built at load time.
+ * Positions of emitted rays are chosen like for the constant background light.
+ */
+class EnvironmentLight : public Light {
+public: /* Methods: */
+
+    EnvironmentLight(const SceneSphere& sceneSphere, const Textures& textures,
+                     texture_index_t index, floating scale)
+        : Light{sceneSphere, average(*textures[index]) * scale, false, false}
+        , m_map(*textures[index])
+        , m_mapIndex{index}
+        , m_scale{scale}
+        , m_integral{0}
+    {
+        const auto w = m_map.width();
+        const auto h = m_map.height();
+        std::vector<floating> func(w * h);
+        for (size_t y = 0; y < h; ++y) {
+            const auto sinTheta = std::sin(RAY_PI * (y + 0.5) / h);
+            for (size_t x = 0; x < w; ++x) {
+                const auto f = luminance(m_map(x, y)) * m_scale * sinTheta;
+                func[y * w + x] = f;
+                m_integral += f;
+            }
+        }
+
+        m_integral *= 2.0 * RAY_PI * RAY_PI / (w * h);
+        m_distribution.build(func.data(), w, h);
+    }
+
+    IlluminateResult illuminate(Point, Sampler& sampler) const override {
+        floating   mapPdf;
+        const auto u = sampler.get2D();
+        const auto uv = m_distribution.sample(u.x, u.y, mapPdf);
+        const auto direction = toDirection(uv);
+        const auto directPdfW = directionPdfW(uv, mapPdf);
+        if (directPdfW <= 0.0)
+            return {};
+
+        const auto emissionPdfW =
+            directPdfW * concentricDiscPdfA() * sceneSphere().invRadiusSqr();
+
+        return {lookup(uv),  direction,    std::numeric_limits<floating>::max(),
+                directPdfW,  emissionPdfW, 1.0};
+    }
+
+    EmitResult emit(Sampler& sampler) const override {
+        // Sample direction, light travels the opposite way:
+        Vector2  uv;
+        floating directPdfW;
+        do {
+            floating   mapPdf;
+            const auto u = sampler.get2D();
+            uv = m_distribution.sample(u.x, u.y, mapPdf);
+            directPdfW = directionPdfW(uv, mapPdf);
+        } while (directPdfW <= 0.0);
+
+        const auto direction = -toDirection(uv);
+
+        // Sample position:
+        const auto frame = Frame{direction};
+        const auto discSample = sampleConcentricDisc(sampler);
+        const auto offset =
+            sceneSphere().center() + sceneSphere().radius() * (-direction);
+        const auto x = discSample.get().x;
+        const auto y = discSample.get().y;
+        const auto vecFromDiscCenter =
+            frame.binormal() * x + frame.tangent() * y;
+        const auto position =
+            offset + sceneSphere().radius() * vecFromDiscCenter;
+
+        const auto emissionPdfW = directPdfW * concentricDiscPdfA() *
+                                  sceneSphere().invRadiusSqr();
+
+        return {lookup(uv),   position,   direction, direction,
+                emissionPdfW, directPdfW, 1.0};
+    }
+
+    RadianceResult radiance(Point, Vector dir) const override {
+        const auto uv = toUV(dir);
+        const auto directPdf = directionPdfW(uv, m_distribution.pdf(uv));
+        const auto positionPdf =
+            concentricDiscPdfA() * sceneSphere().invRadiusSqr();
+        const auto emissionPdfW = directPdf * positionPdf;
+        return {lookup(uv), emissionPdfW, directPdf};
+    }
+
+    floating power() const override {
+        return m_integral * RAY_PI / sceneSphere().invRadiusSqr();
+    }
+
+    void write(BinaryWriter& out) const override {
+        writeHeader(out, LightType::Environment);
+        out.write(m_mapIndex);
+        out.write(m_scale);
+    }
+
+private: /* Methods: */
+
+    static Colour average(const Texture& map) {
+        auto sum = Colour{0, 0, 0};
+        for (const auto& c : map)
+            sum += c;
+        return sum / floating(map.width() * map.height());
+    }
+
+    static Vector toDirection(Vector2 uv) {
+        const auto phi = 2.0 * RAY_PI * (uv.x - 0.5);
+        const auto theta = RAY_PI * (1.0 - uv.y);
+        const auto sinTheta = std::sin(theta);
+        return Vector{sinTheta * std::cos(phi), std::cos(theta),
+                      sinTheta * std::sin(phi)};
+    }
+
+    static Vector2 toUV(Vector dir) {
+        const auto theta = std::acos(clamp(dir.y, -1, 1));
+        const auto phi = std::atan2(dir.z, dir.x);
+        return Vector2{clamp(phi * 0.5 * RAY_INV_PI + 0.5, 0, 1),
+                       clamp(1.0 - theta * RAY_INV_PI, 0, 1)};
+    }
+
+    /// Converts density on [0, 1)^2 to density with respect to solid angle.
+    static floating directionPdfW(Vector2 uv, floating mapPdf) {
+        const auto sinTheta = std::sin(RAY_PI * (1.0 - uv.y));
+        if (sinTheta <= 0.0)
+            return 0.0;
+
+        return mapPdf / (2.0 * RAY_PI * RAY_PI * sinTheta);
+    }
+
+    /// Nearest texel so that radiance is constant where the density is.
+    Colour lookup(Vector2 uv) const {
+        const auto w = m_map.width();
+        const auto h = m_map.height();
+        const auto x = std::min((size_t)(uv.x * w), w - 1);
+        const auto y = std::min((size_t)(uv.y * h), h - 1);
+        return m_map(x, y) * m_scale;
+    }
+
+private: /* Fields: */
+    const Texture&        m_map;
+    const texture_index_t m_mapIndex;
+    const floating        m_scale;
+    floating              m_integral; ///< Integral of luminance over sphere.
+    Distribution2D        m_distribution;
+};
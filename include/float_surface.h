@@ -0,0 +1,95 @@
+#pragma once
+
+#include "geometry.h"
+#include "surface.h"
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+/**
+ * Linear HDR image of 32-bit floats. The pixels are kept in a writable
+ * memory mapping of the output file, so there is no copy of the image in
+ * memory and the system writes the pages back to disk as they change.
+ * Subclasses lay out the file.
+ */
+class FloatSurface : public Surface {
+public: /* Methods: */
+    explicit FloatSurface(std::string fname)
+        : m_data{nullptr}
+        , m_size{0}
+        , m_fname{std::move(fname)}
+    {}
+
+    /// Writes the image.
+    ~FloatSurface();
+
+    FloatSurface(const FloatSurface&) = delete;
+    FloatSurface& operator=(const FloatSurface&) = delete;
+
+    /// Creates the file and writes everything but the pixels.
+    void init() override;
+
+    void setPixel(int h, int w, const Colour& c) override;
+
+    /// Schedules the changed pixels to be written to the file.
+    void write() override;
+
+protected: /* Types: */
+
+    /// Byte offsets of the pixels in the file, strides may be negative.
+    struct Layout {
+        size_t    size;    ///< Of the whole file.
+        size_t    first;   ///< Red channel of the top left pixel.
+        ptrdiff_t row;     ///< Between rows from the top.
+        ptrdiff_t pixel;   ///< Between pixels of a row.
+        ptrdiff_t channel; ///< From red to green and from green to blue.
+    };
+
+protected: /* Methods: */
+    virtual Layout layout() const = 0;
+    virtual void writeHeader(char* data) const = 0;
+
+private: /* Methods: */
+    void unmap();
+
+private: /* Fields: */
+    char*             m_data;
+    size_t            m_size;
+    Layout            m_layout;
+    const std::string m_fname;
+};
+
+/// Portable float map, rows are stored from bottom to top.
+class PfmSurface : public FloatSurface {
+public: /* Methods: */
+    explicit PfmSurface(std::string fname)
+        : FloatSurface{std::move(fname)}
+    {}
+
+protected: /* Methods: */
+    Layout layout() const override;
+    void writeHeader(char* data) const override;
+
+private: /* Methods: */
+    std::string header() const;
+};
+
+/**
+ * Uncompressed scanline OpenEXR image with float red, green and blue
+ * channels. Channels of a scanline are stored one after another in
+ * alphabetical order.
+ */
+class ExrSurface : public FloatSurface {
+public: /* Methods: */
+    explicit ExrSurface(std::string fname)
+        : FloatSurface{std::move(fname)}
+    {}
+
+protected: /* Methods: */
+    Layout layout() const override;
+    void writeHeader(char* data) const override;
+
+private: /* Methods: */
+    std::string header() const;
+};
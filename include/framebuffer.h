@@ -7,9 +7,54 @@
 
 struct Aabb;
 class Camera;
+class SampleSchedule;
+
+/**
+ * Running mean of the samples of a pixel and variance of their luminance by
+ * Welford's method.
+ */
+struct PixelStatistics {
+    size_t   count;
+    Colour   mean;
+    floating m2; ///< Sum of squared deviations from the mean luminance.
+
+    PixelStatistics()
+        : count{0}
+        , mean{0, 0, 0}
+        , m2{0}
+    {}
+
+    void add(const Colour& c) {
+        const auto delta = luminance(c) - luminance(mean);
+        ++count;
+        mean += (c - mean) / count;
+        m2 += delta * (luminance(c) - luminance(mean));
+    }
+
+    floating variance() const { return count > 1 ? m2 / (count - 1) : 0.0; }
+
+    /// Statistics of the samples of both (Chan et al.).
+    friend PixelStatistics operator+(const PixelStatistics& a,
+                                     const PixelStatistics& b) {
+        if (a.count == 0 || b.count == 0)
+            return a.count == 0 ? b : a;
+
+        const floating  na = a.count, nb = b.count;
+        const auto      delta = luminance(b.mean) - luminance(a.mean);
+        PixelStatistics result;
+        result.count = a.count + b.count;
+        result.mean = (na * a.mean + nb * b.mean) / (na + nb);
+        result.m2 = a.m2 + b.m2 + delta * delta * na * nb / (na + nb);
+        return result;
+    }
+};
 
 /**
  * All methods, apart from those starting with "unsafe" prefix are thread safe.
+ *
+ * Samples of a pixel are averaged over the samples that the pixel received,
+ * while colours splatted by light paths are summed and have to be divided by
+ * the number of passes.
  */
 class Framebuffer : table<Colour> {
 public: /* Methods: */
@@ -40,13 +85,37 @@ public: /* Methods: */
      */
     void addColour(size_t x, size_t y, Colour col);
 
+    /// Adds a sample of the pixel, cached like addColour.
+    void addSample(size_t x, size_t y, Colour col);
+
+    /// Adds the splats and the samples of @a other, which must not change.
+    void add(const Framebuffer& other);
+
+    /// Number of samples the pixel takes in a pass, one without schedule.
+    size_t samples(size_t x, size_t y) const;
+
+    /// Schedule of adaptive sampling, not owned.
+    void setSchedule(const SampleSchedule* schedule) { m_schedule = schedule; }
+
     // draw line on framebuffer. this is useful for debugging
     // (for instance to draw kd-tree, bounding boxes or traced rays)
     void unsafeDrawLine(floating fx0, floating fy0, floating fx1, floating fy1,
                         Colour col);
     void unsafeDrawAabb(const Camera& cam, const Aabb& box, Colour col);
+    /// Sum of the splatted colours.
     Colour unsafeGetPixel(size_t x, size_t y) const { return (*this)(x, y); }
 
+    const PixelStatistics& unsafeGetStatistics(size_t x, size_t y) const {
+        return m_statistics(x, y);
+    }
+
+    /// Sets the splats and the statistics of a saved pixel.
+    void unsafeRestore(size_t x, size_t y, Colour splats,
+                       const PixelStatistics& stats) {
+        unsafePutColour(x, y, splats);
+        m_statistics(x, y) = stats;
+    }
+
     using table<Colour>::width;
     using table<Colour>::height;
 
@@ -63,5 +132,24 @@ private:
     }
 
 private: /* Fields: */
-    mutable boost::mutex m_mutex;
+    mutable boost::mutex   m_mutex;
+    table<PixelStatistics> m_statistics;
+    const SampleSchedule*  m_schedule;
 };
+
+/// Mean of the samples of the pixel plus the splats of @a passes passes.
+inline Colour pixelColour(const Framebuffer& buf, size_t x, size_t y,
+                          size_t passes) {
+    return buf.unsafeGetStatistics(x, y).mean +
+           buf.unsafeGetPixel(x, y) / passes;
+}
+
+/// Colour of the pixel of an image whose even and odd passes are apart.
+inline Colour pixelColour(const Framebuffer (&halves)[2], size_t x, size_t y,
+                          const size_t (&passes)[2]) {
+    const auto stats = halves[0].unsafeGetStatistics(x, y) +
+                       halves[1].unsafeGetStatistics(x, y);
+    const auto splats =
+        halves[0].unsafeGetPixel(x, y) + halves[1].unsafeGetPixel(x, y);
+    return stats.mean + splats / (passes[0] + passes[1]);
+}
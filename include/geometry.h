@@ -253,6 +253,25 @@ public: /* Methods: */
         return result;
     }
 
+    friend bool operator==(const Matrix& m1, const Matrix& m2) {
+        for (size_t i = 0; i < 16; ++i)
+            if (m1[i] != m2[i])
+                return false;
+        return true;
+    }
+
+    friend bool operator!=(const Matrix& m1, const Matrix& m2) {
+        return !(m1 == m2);
+    }
+
+    friend Matrix transpose(const Matrix& m) {
+        Matrix result;
+        for (size_t r = 0; r < 4; ++r)
+            for (size_t c = 0; c < 4; ++c)
+                result(r, c) = m(c, r);
+        return result;
+    }
+
     // http://stackoverflow.com/questions/1148309/inverting-a-4x4-matrix
     friend Matrix invert(const Matrix& m) {
         auto inv = Matrix{};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "geometry.h"
+#include "statistics.h"
 
 #include <algorithm>
 #include <cassert>
@@ -82,8 +83,10 @@ public: /* Methods: */
             {pxo, py, pz}, {pxo, py, pzo}, {pxo, pyo, pz}, {pxo, pyo, pzo}};
 
         size_t hits = 0;
+        size_t probes = 0;
         for (size_t i = 0; i < 8; ++i) {
             const auto idx = hash(coords[i][0], coords[i][1], coords[i][2]);
+            probes += cellEnd(idx) - cellBegin(idx);
             for (size_t j = cellBegin(idx); j < cellEnd(idx); ++j) {
                 const auto iter = begin + m_indices[j];
                 const auto particlePos = iter->position();
@@ -94,6 +97,10 @@ public: /* Methods: */
                 }
             }
         }
+
+        auto& statistics = threadStatistics();
+        ++statistics.gridQueries;
+        statistics.gridProbes += probes;
     }
 
 private:
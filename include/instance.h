@@ -0,0 +1,151 @@
+#pragma once
+
+#include "aabb.h"
+#include "binary_io.h"
+#include "geometry.h"
+#include "intersection.h"
+#include "kdtree_primitive_manager.h"
+#include "primitive.h"
+#include "ray.h"
+
+#include <cassert>
+#include <cstdint>
+
+/**
+ * Geometry that is shared by instances. Primitives of the prototype are in
+ * its own coordinate system and have a kd-tree of their own, which is built
+ * once no matter how many times the prototype is instanced.
+ */
+class Prototype {
+public: /* Methods: */
+
+    Prototype() : m_index{0} {}
+
+    /// Prototype takes ownership of the primitive.
+    void addPrimitive(const Primitive* prim) { m_manager.addPrimitive(prim); }
+
+    /// Builds the kd-tree, no primitives can be added after this.
+    void init() { m_manager.init(); }
+
+    bool empty() const { return m_manager.primitives().empty(); }
+
+    const KdTreePrimitiveManager& manager() const { return m_manager; }
+    KdTreePrimitiveManager& manager() { return m_manager; }
+
+    /// Bounding box in object space.
+    const Aabb& bounds() const { return m_manager.bounds(); }
+
+    /// Position of the prototype in the scene, the cache refers to it by it.
+    uint32_t index() const { return m_index; }
+    void setIndex(uint32_t index) { m_index = index; }
+
+    Intersection intersect(const Ray& ray) const {
+        return m_manager.intersectWithPrims(ray);
+    }
+
+private: /* Fields: */
+    KdTreePrimitiveManager m_manager;
+    uint32_t               m_index;
+};
+
+/**
+ * Placement of a prototype in the scene by an affine transformation. Rays are
+ * transformed to object space and intersected with the prototype, the
+ * intersection records the primitive of the prototype together with the
+ * instance. Primitives keep their own materials unless the instance
+ * overrides them with its own.
+ */
+class Instance : public Primitive {
+public: /* Methods: */
+
+    /// The kd-tree of the prototype must have been built.
+    Instance(const Prototype& prototype, const Matrix& toWorld,
+             bool overridesMaterial = false)
+        : m_prototype(&prototype)
+        , m_overridesMaterial{overridesMaterial}
+    {
+        setTransform(toWorld);
+    }
+
+    const Prototype& prototype() const { return *m_prototype; }
+
+    const Matrix& toWorld() const { return m_toWorld; }
+
+    /**
+     * Moves the instance. The primitive manager that holds the instance must
+     * be updated before it is used again.
+     */
+    void setTransform(const Matrix& toWorld) {
+        m_toWorld = toWorld;
+        m_toObject = invert(toWorld);
+        m_normalToWorld = transpose(m_toObject);
+
+        const auto& box = m_prototype->bounds();
+        for (int i = 0; i < 8; ++i) {
+            const auto corner = toWorld.transform(
+                Point{(i & 1 ? box.m_p2 : box.m_p1)[0],
+                      (i & 2 ? box.m_p2 : box.m_p1)[1],
+                      (i & 4 ? box.m_p2 : box.m_p1)[2]});
+            for (size_t axis = 0; axis < 3; ++axis) {
+                if (i == 0 || corner[axis] < m_bounds.m_p1[axis])
+                    m_bounds.m_p1[axis] = corner[axis];
+                if (i == 0 || corner[axis] > m_bounds.m_p2[axis])
+                    m_bounds.m_p2[axis] = corner[axis];
+            }
+        }
+    }
+
+    /// Material of the instance replaces the materials of the prototype.
+    bool overridesMaterial() const { return m_overridesMaterial; }
+
+    Point toObject(const Point& pos) const { return m_toObject.transform(pos); }
+
+    /// World space normal of the primitive @a prim of the prototype.
+    Vector normal(const Primitive& prim, const Point& pos) const {
+        const auto N = prim.normal(toObject(pos));
+        return normalised(m_normalToWorld.transform(N));
+    }
+
+    // Object space distances differ from world space distances by the length
+    // of the transformed direction.
+    void intersect(const Ray& ray, Intersection& intr) const override {
+        const auto dir = m_toObject.transform(ray.dir());
+        const auto scale = dir.length();
+        const auto local = m_prototype->intersect(
+            Ray{m_toObject.transform(ray.origin()), dir / scale});
+        if (local.hasIntersections())
+            intr.update(ray, local.getPrimitive(), this, local.dist() / scale);
+    }
+
+    /// Instances are never reported as the intersected primitive.
+    Vector normal(const Point&) const override {
+        assert(false && "Instance::normal");
+        return Vector{0, 0, 0};
+    }
+
+    floating getLeftExtreme(size_t axis) const override {
+        return m_bounds.m_p1[axis];
+    }
+
+    floating getRightExtreme(size_t axis) const override {
+        return m_bounds.m_p2[axis];
+    }
+
+    /// Writes the index of the prototype and the transformation.
+    void write(BinaryWriter& out) const override {
+        out.write(static_cast<uint8_t>(PrimitiveType::Instance));
+        out.write(m_prototype->index());
+        for (size_t r = 0; r < 3; ++r)
+            for (size_t c = 0; c < 4; ++c)
+                out.write(m_toWorld(r, c));
+        out.write<uint8_t>(m_overridesMaterial);
+    }
+
+private: /* Fields: */
+    const Prototype* m_prototype;
+    Matrix           m_toWorld;
+    Matrix           m_toObject;
+    Matrix           m_normalToWorld; ///< Inverse transpose of m_toWorld.
+    Aabb             m_bounds;        ///< World space bounding box.
+    const bool       m_overridesMaterial;
+};
@@ -1,36 +1,70 @@
 #pragma once
 
 #include "geometry.h"
+#include "material.h"
 #include "ray.h"
+#include "texture.h"
 
+class Instance;
 class Primitive;
 
 /// Representation of intersection of ray and object.
 class Intersection {
 public: /* Methods: */
 
-    Intersection() : m_primitive {nullptr} {}
+    Intersection()
+        : m_primitive {nullptr}
+        , m_instance {nullptr}
+    {}
 
     const Point& point() const { return m_point; }
 
     floating dist() const { return m_dist; }
 
+    /// Intersected primitive, for instanced geometry the primitive of the
+    /// prototype.
     const Primitive* getPrimitive() const { return m_primitive; }
 
-    void nullPrimitive() { m_primitive = nullptr; }
+    /// Instance through which the primitive was hit, if any.
+    const Instance* instance() const { return m_instance; }
+
+    void nullPrimitive() {
+        m_primitive = nullptr;
+        m_instance = nullptr;
+    }
 
     bool hasIntersections() const { return m_primitive != nullptr; }
 
     void update(const Ray& ray, const Primitive* prim, floating dist) {
+        update(ray, prim, nullptr, dist);
+    }
+
+    void update(const Ray& ray, const Primitive* prim, const Instance* instance,
+                floating dist) {
         if (dist > 0.0 && (!hasIntersections() || dist < this->dist())) {
             m_primitive = prim;
+            m_instance = instance;
             m_dist = dist;
             m_point = ray.origin() + dist * ray.dir();
         }
     }
 
+    /// Surface normal at the point of intersection.
+    Vector normal() const;
+
+    /// Material of the primitive or the instance that overrides it.
+    material_index_t material() const;
+
+    /// Texture of the primitive, none (-1) if the instance overrides the
+    /// material.
+    texture_index_t texture() const;
+
+    /// Colour of @a texture at the point of intersection.
+    Colour texel(const Texture* texture) const;
+
 private: /* Fields: */
     const Primitive* m_primitive; ///< Intersected primitive.
+    const Instance*  m_instance;  ///< Instance of the primitive.
     Point            m_point;     ///< Point of intersection.
     floating         m_dist;      ///< Distance from origin.
 };
@@ -19,6 +19,13 @@ public: /* Methods: */
 
     void init() override;
     void addPrimitive(const Primitive* p) override;
+    void clear() override;
+    void reserve(size_t n) override { m_prims.reserve(n); }
+    const PrimList& primitives() const override { return m_prims; }
+    const Aabb& bounds() const { return m_bbox; }
+    void update(const PrimList& moved) override;
+    void write(BinaryWriter& out) const override;
+    bool read(BinaryReader& in) override;
     void setSceneSphere(SceneSphere& sceneSphere) const override;
     Intersection intersectWithPrims(const Ray& ray) const override;
     void debugDrawOnFramebuffer(const Camera& cam,
@@ -1,8 +1,25 @@
 #pragma once
 
+#include "binary_io.h"
 #include "geometry.h"
 #include "scene_sphere.h"
 
+#include <cstdint>
+
+class Sampler;
+
+/// Identifies the kind of a light in the binary scene cache.
+enum class LightType : uint8_t {
+    Point,
+    Sphere,
+    Area,
+    Triangle,
+    Directional,
+    Spot,
+    Background,
+    Environment
+};
+
 class Light {
 public: /* Types: */
     /**
@@ -90,12 +107,25 @@ public: /* Methods: */
 
     void setSamplingPr(floating pr) { m_samplingPr = pr; }
 
-    virtual IlluminateResult illuminate(Point pos) const = 0;
+    virtual IlluminateResult illuminate(Point pos, Sampler& sampler) const = 0;
 
-    virtual EmitResult emit() const = 0;
+    virtual EmitResult emit(Sampler& sampler) const = 0;
 
     virtual RadianceResult radiance(Point pos, Vector dir) const = 0;
 
+    /// Luminance of the total emitted power. Lights are picked proportionally.
+    virtual floating power() const = 0;
+
+    /// Writes the type and the constructor arguments of the light.
+    virtual void write(BinaryWriter& out) const = 0;
+
+protected: /* Methods: */
+
+    void writeHeader(BinaryWriter& out, LightType type) const {
+        out.write(static_cast<uint8_t>(type));
+        out.writeVector(m_intensity);
+    }
+
 private: /* Fields: */
     const SceneSphere& m_sceneSphere;
     Colour             m_intensity;
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "distribution.h"
+
+#include <memory>
+#include <vector>
+
+class Light;
+
+/**
+ * Picks lights proportionally to their emitted power in constant time.
+ * Building the sampler also updates the sampling probability of every light.
+ */
+class LightSampler {
+public: /* Methods: */
+
+    void build(const std::vector<std::unique_ptr<Light>>& lights);
+
+    /// Maps uniformly distributed @a u to a light, returns null if no lights.
+    Light* pick(floating u) const {
+        if (m_lights.empty())
+            return nullptr;
+
+        return m_lights[m_table.sample(u)];
+    }
+
+private: /* Fields: */
+    std::vector<Light*> m_lights;
+    AliasTable          m_table;
+};
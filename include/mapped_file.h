@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Read-only memory mapping of a whole file. The contents are not null
+ * terminated, use begin() and end() to delimit them.
+ */
+class MappedFile {
+public: /* Methods: */
+
+    explicit MappedFile(const std::string& fname);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return m_open; }
+
+    const char* begin() const { return m_data; }
+    const char* end() const { return m_data + m_size; }
+    size_t size() const { return m_size; }
+
+private: /* Fields: */
+    const char* m_data;
+    size_t      m_size;
+    bool        m_open;
+};
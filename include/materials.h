@@ -26,6 +26,15 @@ public: /* Methods: */
 
     static material_index_t lightMaterial() { return 0; }
 
+    size_t size() const { return m_materials.size(); }
+
+    /// Removes all but the light material.
+    void clear() {
+        impl_t materials;
+        materials.push_back(m_materials[lightMaterial()]);
+        materials.swap(m_materials);
+    }
+
     void shrink_to_fit() { impl_t(m_materials).swap(m_materials); }
 
 private: /* Fields: */
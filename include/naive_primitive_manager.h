@@ -21,6 +21,14 @@ public: /* Methods: */
 
     void addPrimitive(const Primitive* p) override { m_prims.push_back(p); }
 
+    void clear() override;
+
+    void reserve(size_t n) override { m_prims.reserve(n); }
+
+    const std::vector<const Primitive*>& primitives() const override {
+        return m_prims;
+    }
+
     void setSceneSphere(SceneSphere& sceneSphere) const override;
 
     Intersection intersectWithPrims(const Ray& ray) const override;
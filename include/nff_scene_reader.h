@@ -8,5 +8,5 @@ public: /* Methods: */
 
     ~NFFSceneReader() {}
 
-    SceneReader::Status init(Scene &scene) const;
+    SceneReader::Status init(Scene &scene, std::string &error) const;
 };
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "scene_reader.h"
+
+/**
+ * Reads Wavefront OBJ files with MTL materials. Polygons are stored to
+ * triangle meshes. As OBJ has neither camera nor lights the camera looks at
+ * the model along the negative z-axis, emissive materials (Ke) become area
+ * lights and if there are none the scene is lit by a white background.
+ */
+class OBJSceneReader : public SceneReader {
+public: /* Methods: */
+    OBJSceneReader(char const *fname) : SceneReader(fname) {}
+
+    ~OBJSceneReader() {}
+
+    SceneReader::Status init(Scene &scene, std::string &error) const;
+};
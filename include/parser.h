@@ -1,5 +1,21 @@
 #pragma once
 
+#include "camera.h"
 #include "scene.h"
+#include "tokenizer.h"
 
-int nff2scene(Scene&, char const*);
+#include <string>
+#include <vector>
+
+/// Reads the scene from an NFF file. @retval false with the reason in
+/// @a error if the file can not be read or has an error.
+bool nff2scene(Scene&, char const*, std::string& error);
+
+/// Reads the rest of a "v" statement. @retval false on syntax error or if
+/// the angle, hither or resolution of the view is out of range.
+bool readView(Tokenizer&, Camera::Parameters&);
+
+/// Reads the "v" statements of a file of views, the rest must be comments.
+/// @retval false if the file can not be read or has a syntax error, which is
+/// reported.
+bool nff2views(std::vector<Camera::Parameters>&, char const*);
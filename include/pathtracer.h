@@ -16,8 +16,10 @@
 
 // TODO: i think that our material representation is all wrong...
 
+// Material that neither scatters nor transmits (a light source) is black.
 inline floating diffusePr (const Material& m) {
-    return m.kd () / (m.kd () + m.ks () + m.t ());
+    const auto total = m.kd () + m.ks () + m.t ();
+    return total > 0.0 ? m.kd () / total : 0.0;
 }
 
 inline floating reflectPr (const Material& m) {
@@ -46,15 +48,20 @@ public: /* Types: */
             const Light*     m_light;
         };
 
-        floating  m_pr;
-        EventType m_event;
+        const Material* m_material; ///< Surface material, null for lights.
+        Colour          m_surface;  ///< Surface colour at the vertex.
+        floating        m_pr;
+        EventType       m_event;
 
         Vertex(Point pos, Vector normal, Colour col, const Primitive* prim,
-               floating pr, EventType event)
+               const Material* material, Colour surface, floating pr,
+               EventType event)
             : m_pos{pos}
             , m_normal{normal}
             , m_col{col}
             , m_prim{prim}
+            , m_material{material}
+            , m_surface{surface}
             , m_pr{pr}
             , m_event{event}
         {}
@@ -65,6 +72,8 @@ public: /* Types: */
             , m_normal{normal}
             , m_col{col}
             , m_light{light}
+            , m_material{nullptr}
+            , m_surface{0, 0, 0}
             , m_pr{pr}
             , m_event{event}
         {}
@@ -99,7 +108,9 @@ private: /* Methods: */
     Pathtracer& operator=(const Pathtracer&) = delete;
     Pathtracer(const Pathtracer&) = delete;
 
-    Intersection intersectWithPrims(const Ray& ray) const {
+    Intersection intersectWithPrims(const Ray& ray,
+                                    RenderStatistics::RayType type) const {
+        threadStatistics().addRay(type);
         return m_scene.manager().intersectWithPrims(ray);
     }
 
@@ -112,9 +123,9 @@ private: /* Methods: */
         return {from + d * ray_epsilon, d};
     }
 
-    static inline EventType getEventType(const Material& m) {
+    static inline EventType getEventType(const Material& m, Sampler& sampler) {
         const auto total = m.kd() + m.ks() + m.t();
-        const auto r = total * rng();
+        const auto r = total * sampler.get1D();
         if (r < m.kd())
             return DIFFUSE;
         if (r < m.kd() + m.ks())
@@ -156,7 +167,8 @@ private: /* Methods: */
             return 0.0;
 
         const auto testRay = Ray{from.m_pos.nudgePoint(from2to), from2to};
-        const auto intr = intersectWithPrims(testRay);
+        const auto intr =
+            intersectWithPrims(testRay, RenderStatistics::ConnectionRay);
         if (!intr.hasIntersections())
             return 0.0;
 
@@ -180,73 +192,79 @@ public: /* Methods: */
     Colour operator()(Ray ray) { return run(ray); }
 
 private: /* Methods: */
-    Colour getPrimColour(const Primitive* prim, const Point& point) const {
-        const auto& m = m_scene.materials()[prim->material()];
-        if (prim->texture() >= 0) {
-            const Texture* texture = m_scene.textures()[prim->texture()];
-            return prim->getColourAtIntersection(point, texture);
+    Colour getPrimColour(const Intersection& intr) const {
+        const auto index = intr.texture();
+        if (index >= 0) {
+            const Texture* texture = m_scene.textures()[index];
+            return intr.texel(texture);
         }
 
-        return m.colour();
+        return m_scene.materials()[intr.material()].colour();
     }
 
     // TODO: proper brdf, this thing is a huge hack
-    inline Colour brdf(const Primitive* prim, const Point& p) {
-        const auto& m = getMat(prim);
+    inline Colour brdf(const Vertex& v) {
+        const auto& m = getMat(v);
         if (reflectPr(m) > 0.0)
             return Colour{0, 0, 0};
         if (refractPr(m) > 0.0)
             return Colour{0, 0, 0};
-        return getPrimColour(prim, p) * diffusePr(m) / M_PI;
+        return v.m_surface * diffusePr(m) / M_PI;
     }
 
-    void trace(Ray ray, VertexList& vertices) {
-        size_t depth = 1;
+    void trace(Ray ray, VertexList& vertices,
+               RenderStatistics::RayType type) {
+        const auto& russianRoulette = m_scene.russianRoulette();
+        auto        throughput = Colour{1, 1, 1}; // relative to path start
+        size_t      depth = 1;
         while (depth < 5) {
-            const auto intr = intersectWithPrims(ray);
+            const auto intr = intersectWithPrims(ray, type);
             if (!intr.hasIntersections()) {
                 return;
             }
 
             const auto prim = intr.getPrimitive();
-            const auto m = m_scene.materials()[prim->material()];
+            const auto m = m_scene.materials()[intr.material()];
             const auto point = intr.point();
-            const auto objCol = getPrimColour(prim, point);
+            const auto objCol = getPrimColour(intr);
             const auto V = ray.dir();
-            const auto N = prim->normal(point);
+            const auto N = intr.normal();
             const auto internal = V.dot(N) > 0.0;
             const auto N2 = internal ? -N : N;
-            auto       pr = clamp(luminance(objCol), 0, 1);
-
-            if (depth > RAY_MAX_REC_DEPTH) {
-                if (pr <= rng()) {
-                    vertices.emplace_back(point, N2, Colour{0.0, 0.0, 0.0},
-                                          prim, 0.0, DIFFUSE);
-                    return;
-                }
-            } else {
-                pr = 1.0;
+            const auto pr = russianRoulette.survivalPr(
+                depth, luminance(throughput * objCol));
+            const auto addVertex = [&](Colour col, floating vertexPr,
+                                       EventType event) {
+                vertices.emplace_back(point, N2, col, prim,
+                                      &m_scene.materials()[intr.material()],
+                                      objCol, vertexPr, event);
+            };
+
+            // The path ends at a light, so its emission is never rouletted.
+            if (prim->emissive()) {
+                addVertex(objCol / M_PI, 1.0 / M_PI, DIFFUSE);
+                return;
             }
 
-            if (prim->emissive()) {
-                vertices.emplace_back(point, N2, objCol / M_PI, prim, pr / M_PI,
-                                      DIFFUSE);
+            if (pr <= sampler().get1D()) {
+                addVertex(Colour{0.0, 0.0, 0.0}, 0.0, DIFFUSE);
                 return;
             }
 
-            switch (getEventType(m)) {
+            throughput = throughput * objCol / pr;
+
+            switch (getEventType(m, sampler())) {
             case DIFFUSE: {
                 const auto frame = Frame::fromNormalised(N2);
-                const auto sample = sampleCosHemisphere();
+                const auto sample = sampleCosHemisphere(sampler());
                 const auto dir = frame.toWorld(sample.get());
-                vertices.emplace_back(point, N2, objCol / M_PI, prim, pr / M_PI,
-                                      DIFFUSE);
+                addVertex(objCol / M_PI, pr / M_PI, DIFFUSE);
                 ray = shootRay(point, dir);
                 break;
             }
             case REFLECT: {
                 const auto dir = reflect(V, N2);
-                vertices.emplace_back(point, N2, objCol, prim, pr, REFLECT);
+                addVertex(objCol, pr, REFLECT);
                 ray = shootRay(point, dir);
                 break;
             }
@@ -259,7 +277,7 @@ private: /* Methods: */
                 const auto sinT2 = n * n * (1.0 - cosI * cosI);
                 if (sinT2 > 1.0) { // TIR
                     const auto dir = reflect(V, N2);
-                    vertices.emplace_back(point, N2, objCol, prim, pr, REFLECT);
+                    addVertex(objCol, pr, REFLECT);
                     ray = shootRay(point, dir);
                     break;
                 }
@@ -268,15 +286,13 @@ private: /* Methods: */
                 const auto T = normalised(n * V + N2 * (n * cosI - cosT));
                 const auto Re = fresnel(cosI, n1, n2);
                 const auto Tr = 1.0 - Re;
-                if (rng() < Re) {
+                if (sampler().get1D() < Re) {
                     const auto reflDir = reflect(V, N2);
-                    vertices.emplace_back(point, N2, Re * objCol, prim, pr * Re,
-                                          REFLECT);
+                    addVertex(Re * objCol, pr * Re, REFLECT);
                     ray = shootRay(point, reflDir);
                     break;
                 } else {
-                    vertices.emplace_back(point, N2, Tr * objCol, prim, pr * Tr,
-                                          REFRACT);
+                    addVertex(Tr * objCol, pr * Tr, REFRACT);
                     ray = shootRay(point, T);
                     break;
                 }
@@ -295,7 +311,10 @@ private: /* Methods: */
     Colour run(const Ray& ray) {
         floating   eyePA, lightPA;
         const auto evs = traceEye(ray, eyePA);
+        sampler().startLightPath();
         const auto lvs = traceLight(lightPA);
+        recordEyePath(evs.size());
+        recordLightPath(lvs.size());
         return radiance(eyePA, std::move(evs), lightPA, std::move(lvs));
     }
 
@@ -304,42 +323,33 @@ private: /* Methods: */
         VertexList vertices;
         vertices.reserve(RAY_MAX_REC_DEPTH);
         eyePA = 1.0;
-        trace(R, vertices);
+        trace(R, vertices, RenderStatistics::CameraRay);
         return vertices;
     }
 
     Light* pickLight() {
-        floating acc = 0.0;
-        for (const auto& l : m_scene.lights()) {
-            acc += l->samplingPr();
-            if (rng() <= acc) {
-                return l.get();
-            }
-        }
-
-        assert(acc >= 1.0);
-        assert(false && "Unreachable code.");
-        return nullptr;
+        return m_scene.lightSampler().pick(sampler().get1D());
     }
 
     VertexList traceLight(floating& lightPA) {
         assert(!m_scene.lights().empty());
         const auto light = pickLight();
-        const auto emission = light->emit();
-        lightPA = emission.directPdfA;
+        const auto emission = light->emit(sampler());
+        lightPA = emission.directPdfA * light->samplingPr();
         VertexList vertices;
         vertices.reserve(RAY_MAX_REC_DEPTH);
         vertices.emplace_back(
             emission.position, emission.normal, emission.energy, light,
             clamp(1.0 / (2.0 * M_PI * emission.cosTheta), 0.0, 1.0), LIGHT);
-        trace(shootRay(emission.position, emission.direction), vertices);
+        trace(shootRay(emission.position, emission.direction), vertices,
+              RenderStatistics::LightRay);
         return vertices;
     }
 
-    const Material& getMat(const Primitive* prim) const {
-        if (prim == nullptr)
+    const Material& getMat(const Vertex& v) const {
+        if (v.m_material == nullptr)
             return m_scene.background();
-        return m_scene.materials()[prim->material()];
+        return *v.m_material;
     }
 
     Colour radiance(floating eyePA, const VertexList& eyeVertices,
@@ -369,13 +379,13 @@ private: /* Methods: */
                 if (s == 1) {
                     brdf0 = Colour{1.0, 1.0, 1.0} / M_PI;
                 } else {
-                    brdf0 = brdf(lv.m_prim, lv.m_pos);
+                    brdf0 = brdf(lv);
                 }
 
                 if (t == 1) {
-                    brdf1 = brdf(ev.m_prim, ev.m_pos);
+                    brdf1 = brdf(ev);
                 } else {
-                    brdf1 = brdf(ev.m_prim, ev.m_pos);
+                    brdf1 = brdf(ev);
                 }
 
                 c(s, t) = gcache(&lv, &ev) * brdf0 * brdf1;
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "common.h"
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * PCG32 random number generator (O'Neill). The whole state is two 64-bit
+ * words, so generators are cheap to keep per path and to seed from a counter
+ * such as the pixel and the sample index. Generators of different streams are
+ * independent even if seeded with the same state.
+ */
+class Pcg32 {
+public: /* Types: */
+    using result_type = uint32_t;
+
+public: /* Methods: */
+
+    explicit Pcg32(uint64_t state = 0x853c49e6748fea9bull,
+                   uint64_t stream = 0xda3e39cb94b95bdbull)
+    {
+        seed(state, stream);
+    }
+
+    void seed(uint64_t state, uint64_t stream = 0xda3e39cb94b95bdbull) {
+        m_state = 0;
+        m_inc = (stream << 1) | 1;
+        (*this)();
+        m_state += state;
+        (*this)();
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    result_type operator()() {
+        const auto old = m_state;
+        m_state = old * 6364136223846793005ull + m_inc;
+        const auto xorShifted = uint32_t(((old >> 18) ^ old) >> 27);
+        const auto rot = uint32_t(old >> 59);
+        return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+    }
+
+    /// Uniform in [0, 1), the 32 random bits are put in the mantissa of a
+    /// number in [1, 2).
+    floating uniform() {
+        static_assert(sizeof(floating) == sizeof(uint64_t), "not a double");
+        const auto bits = 0x3ff0000000000000ull | (uint64_t((*this)()) << 20);
+        floating   result;
+        memcpy(&result, &bits, sizeof(result));
+        return result - 1.0;
+    }
+
+private: /* Fields: */
+    uint64_t m_state;
+    uint64_t m_inc;
+};
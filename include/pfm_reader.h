@@ -0,0 +1,8 @@
+#pragma once
+
+class Texture;
+
+#include <string>
+
+/// @return empty texture if the file can not be read.
+Texture readPfm(std::string pfmFileName);
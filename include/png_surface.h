@@ -24,6 +24,8 @@ public: /* Methods: */
      */
     void init();
 
+    void write();
+
     void setPixel(int h, int w, Colour const& c) { data[h][w] = c.getPixel(); }
 
 private:              /* Fields: */
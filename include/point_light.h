@@ -11,7 +11,7 @@ public: /* Methods: */
         , m_position{pos}
     {}
 
-    IlluminateResult illuminate(Point pos) const override {
+    IlluminateResult illuminate(Point pos, Sampler&) const override {
         Vector         direction = m_position - pos;
         const floating distSqr = direction.sqrlength();
         const floating distance = std::sqrt(distSqr);
@@ -20,8 +20,8 @@ public: /* Methods: */
                 distSqr,     uniformSpherePdfW(), 1.0};
     }
 
-    EmitResult emit() const override {
-        const auto sample = sampleUniformSphere();
+    EmitResult emit(Sampler& sampler) const override {
+        const auto sample = sampleUniformSphere(sampler);
         const auto direction = sample.get();
         return {intensity(),   m_position, direction, direction,
                 sample.pdfW(), 1.0,        1.0};
@@ -31,6 +31,15 @@ public: /* Methods: */
         return {{0, 0, 0}, uniformSpherePdfW(), 1.0};
     }
 
+    floating power() const override {
+        return luminance(intensity()) / uniformSpherePdfW();
+    }
+
+    void write(BinaryWriter& out) const override {
+        writeHeader(out, LightType::Point);
+        out.writeVector(m_position);
+    }
+
 private: /* Fields: */
     const Point m_position;
 };
@@ -47,9 +56,9 @@ public: /* Methods: */
 
     // We are sampling points only from hemisphere facing the position.
     // Thus the area that we are sampling from is 2 times smaller.
-    IlluminateResult illuminate(Point pos) const override {
+    IlluminateResult illuminate(Point pos, Sampler& sampler) const override {
         const auto normal = normalised(pos - m_center);
-        const auto hemisphereVec = sampleUniformHemisphere().get();
+        const auto hemisphereVec = sampleUniformHemisphere(sampler).get();
         const auto localPosVec = Frame{normal}.toWorld(hemisphereVec);
         const auto pointOnHemisphere = m_center + m_radius * localPosVec;
         auto       direction = pointOnHemisphere - pos;
@@ -68,19 +77,19 @@ public: /* Methods: */
                 directPdfW,  emissionPdfW, cosNormal};
     }
 
-    EmitResult emit() const override {
-        const auto sample = sampleCosHemisphere();
-        const auto localDir = sample.get();
+    EmitResult emit(Sampler& sampler) const override {
+        auto localDir = sampleCosHemisphere(sampler).get();
+        while (localDir.z < epsilon) // try again if angle is too steep
+            localDir = sampleCosHemisphere(sampler).get();
+
         const auto cosTheta = localDir.z;
-        if (cosTheta < epsilon)
-            return emit();
 
-        const auto localPosVec = sampleUniformSphere().get();
+        const auto localPosVec = sampleUniformSphere(sampler).get();
         const auto pointOnSphere = m_center + m_radius * localPosVec;
         const auto normal = normalised(pointOnSphere - m_center);
         const auto frame = Frame::fromNormalised(normal);
         const auto direction = frame.toWorld(localDir);
-        const auto emissionPdfW = m_invArea * sample.pdfW();
+        const auto emissionPdfW = m_invArea * localCosHemispherePdfW(localDir);
         const auto directPdfA = m_invArea;
         return {cosTheta * intensity(), pointOnSphere, normal,  direction,
                 emissionPdfW,           directPdfA,    cosTheta};
@@ -96,6 +105,16 @@ public: /* Methods: */
                 m_invArea};
     }
 
+    floating power() const override {
+        return luminance(intensity()) * RAY_PI / m_invArea;
+    }
+
+    void write(BinaryWriter& out) const override {
+        writeHeader(out, LightType::Sphere);
+        out.writeVector(m_center);
+        out.write(m_radius);
+    }
+
 private: /* Fields: */
     const Point    m_center;
     const floating m_radius;
@@ -4,10 +4,19 @@
 #include "material.h"
 #include "texture.h"
 
+class BinaryWriter;
 class Intersection;
 class Ray;
 class Light;
 
+/// Identifies the shape of a primitive in the binary scene cache.
+enum class PrimitiveType : uint8_t {
+    Sphere,
+    Rectangle,
+    MeshTriangle,
+    Instance
+};
+
 class Primitive {
 public: /* Methods: */
 
@@ -52,6 +61,9 @@ public: /* Methods: */
     /// Greates coordinate of the primitive on @a axis
     virtual floating getRightExtreme(size_t axis) const = 0;
 
+    /// Writes the type and the shape (but not material, texture or light).
+    virtual void write(BinaryWriter& out) const = 0;
+
 private: /* Fields: */
     material_index_t m_material; ///< Material description of the primitive
     texture_index_t  m_texture;  ///< Texture of the primitive
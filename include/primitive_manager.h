@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstddef>
+#include <vector>
+
+class BinaryReader;
+class BinaryWriter;
 class Camera;
 class Framebuffer;
 class Intersection;
@@ -26,6 +31,12 @@ public: /* Methods: */
     /// Add a primitive to primitive manager.
     virtual void addPrimitive(const Primitive* prim) = 0;
 
+    /// Deletes the primitives, the manager can be filled again.
+    virtual void clear() = 0;
+
+    /// Hint that about @a n primitives are going to be added.
+    virtual void reserve(size_t) {}
+
     virtual void setSceneSphere(SceneSphere& sceneSphere) const = 0;
 
     /**
@@ -35,6 +46,30 @@ public: /* Methods: */
      */
     virtual void init() = 0;
 
+    /// Primitives in the order they were added.
+    virtual const std::vector<const Primitive*>& primitives() const = 0;
+
+    /**
+     * Updates the initialised manager after the given primitives have changed
+     * their position or extent. Must not be called while rays are being
+     * intersected.
+     */
+    virtual void update(const std::vector<const Primitive*>&) {}
+
+    /// Writes the acceleration structure, if any, for the scene cache.
+    virtual void write(BinaryWriter&) const {}
+
+    /**
+     * Initialises the primitive manager from the structure written by
+     * write(). Primitives must have been added in the same order as when
+     * writing.
+     * @retval false if the data is invalid.
+     */
+    virtual bool read(BinaryReader&) {
+        init();
+        return true;
+    }
+
     virtual void debugDrawOnFramebuffer(const Camera&, Framebuffer&) const {}
 
     /// Intersects @a ray with primitives.
@@ -3,21 +3,22 @@
 #include "common.h"
 #include "frame.h"
 #include "geometry.h"
+#include "pcg32.h"
+#include "sampler.h"
 
+#include <algorithm>
 #include <random>
 
 /**
- * Random number generation and sampling.
+ * Random number generation and sampling. Sampling functions take their
+ * random numbers from the given sampler.
  */
 
-using Engine = std::mt19937;
+using Engine = Pcg32;
 
 Engine& rng_engine();
 
-inline floating rng() {
-    static auto dist = std::uniform_real_distribution<floating>{0, 1};
-    return dist(rng_engine());
-}
+inline floating rng() { return rng_engine().uniform(); }
 
 template <typename T>
 inline T rngInt(const T n) {
@@ -49,18 +50,43 @@ inline Sample<T> make_sample(T value, floating pdfW) {
 
 /**
  * Point on circle.
+ * Concentric mapping of the unit square to the unit disc (Shirley and Chiu)
+ * keeps the stratification of the samples and takes no rejections.
  */
 
 inline floating concentricDiscPdfA() { return RAY_INV_PI; }
 
-inline Sample<Vector2> sampleConcentricDisc() {
-    floating x, y;
-    do {
-        x = 2.0 * rng() - 1.0;
-        y = 2.0 * rng() - 1.0;
-    } while (x * x + y * y > 1.0);
+inline Vector2 concentricDisc(Vector2 u) {
+    const auto a = 2.0 * u.x - 1.0;
+    const auto b = 2.0 * u.y - 1.0;
+    if (a == 0.0 && b == 0.0)
+        return Vector2{0.0, 0.0};
+
+    floating r, phi;
+    if (a * a > b * b) {
+        r = a;
+        phi = (M_PI / 4.0) * (b / a);
+    } else {
+        r = b;
+        phi = M_PI / 2.0 - (M_PI / 4.0) * (a / b);
+    }
+
+    return Vector2{r * cos(phi), r * sin(phi)};
+}
+
+inline Sample<Vector2> sampleConcentricDisc(Sampler& sampler) {
+    return make_sample(concentricDisc(sampler.get2D()), concentricDiscPdfA());
+}
+
+/**
+ * Uniformly distributed point on triangle.
+ * Returns barycentric coordinates of the second and third vertex.
+ */
 
-    return make_sample(Vector2{x, y}, concentricDiscPdfA());
+inline Vector2 sampleUniformTriangle(Sampler& sampler) {
+    const auto u = sampler.get2D();
+    const auto su = std::sqrt(u.x);
+    return Vector2{1.0 - su, u.y * su};
 }
 
 /**
@@ -69,9 +95,10 @@ inline Sample<Vector2> sampleConcentricDisc() {
 
 inline floating uniformSpherePdfW() { return 1.0 / (4.0 * M_PI); }
 
-inline Sample<Vector> sampleUniformSphere() {
-    const auto r1 = rng();
-    const auto r2 = rng();
+inline Sample<Vector> sampleUniformSphere(Sampler& sampler) {
+    const auto u = sampler.get2D();
+    const auto r1 = u.x;
+    const auto r2 = u.y;
     const auto T1 = 2.0 * M_PI * r1;
     const auto T2 = 2.0 * std::sqrt(r2 * (1.0 - r2));
     const auto vec = Vector{cos(T1) * T2, sin(T1) * T2, 1.0 - 2.0 * r2};
@@ -80,21 +107,40 @@ inline Sample<Vector> sampleUniformSphere() {
 
 inline floating uniformHemispherePdfW() { return 1.0 / (2.0 * M_PI); }
 
-inline Sample<Vector> sampleUniformHemisphere() {
-    auto vec = sampleUniformSphere().get();
+inline Sample<Vector> sampleUniformHemisphere(Sampler& sampler) {
+    auto vec = sampleUniformSphere(sampler).get();
     if (vec.z < 0.0)
         vec.z = -vec.z;
     return make_sample(vec, uniformHemispherePdfW());
 }
 
+/**
+ * Uniformly distributed unit vector in the cone of directions whose angle to
+ * (0, 0, 1) has cosine at least @a cosMax.
+ */
+
+inline floating uniformConePdfW(floating cosMax) {
+    return 1.0 / (2.0 * M_PI * (1.0 - cosMax));
+}
+
+inline Sample<Vector> sampleUniformCone(Sampler& sampler, floating cosMax) {
+    const auto u = sampler.get2D();
+    const auto cosTheta = 1.0 - u.x * (1.0 - cosMax);
+    const auto sinTheta = std::sqrt(std::max(0.0, 1.0 - cosTheta * cosTheta));
+    const auto phi = 2.0 * M_PI * u.y;
+    const auto vec = Vector{cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta};
+    return make_sample(vec, uniformConePdfW(cosMax));
+}
+
 /**
  * cos-weight unit vector in direction (0, 0, 1).
  * Meaning that the z component is always non-negative.
  */
 
-inline Sample<Vector> sampleCosHemisphere() {
-    const auto r1 = rng();
-    const auto r2 = rng();
+inline Sample<Vector> sampleCosHemisphere(Sampler& sampler) {
+    const auto u = sampler.get2D();
+    const auto r1 = u.x;
+    const auto r2 = u.y;
     const auto T1 = 2.0 * M_PI * r1;
     const auto T2 = std::sqrt(1.0 - r2);
     const auto vec = Vector{cos(T1) * T2, sin(T1) * T2, std::sqrt(r2)};
@@ -15,7 +15,9 @@ private: /* Methods: */
     Raytracer& operator=(const Raytracer&) = delete;
     Raytracer(const Raytracer&) = delete;
 
-    Intersection intersectWithPrims(const Ray& ray) const {
+    Intersection intersectWithPrims(const Ray& ray,
+                                    RenderStatistics::RayType type) const {
+        threadStatistics().addRay(type);
         return m_scene.manager().intersectWithPrims(ray);
     }
 
@@ -32,9 +34,15 @@ public: /* Methods: */
 
     explicit Raytracer(const Scene& s)
         : Renderer{s}
+        , m_pathLength{0}
     { }
 
-    Colour render(Ray ray) { return run(ray); }
+    Colour render(Ray ray) {
+        m_pathLength = 0;
+        const auto colour = run(ray);
+        recordEyePath(m_pathLength);
+        return colour;
+    }
 
     std::unique_ptr<Renderer> clone() const {
         return std::unique_ptr<Renderer>{new Raytracer{m_scene}};
@@ -45,10 +53,11 @@ private: /* Methods: */
     // TODO: giant hack, we just sample a single point on the light source
     // and if the point isnt visible we are completely in shadow.
     Colour getShade(const Light* l, Point point, Vector& L) {
-        const auto illumination = l->illuminate(point);
+        const auto illumination = l->illuminate(point, sampler());
         L = illumination.direction;
         const auto ray = shootRay(point, illumination.direction);
-        const auto intr = intersectWithPrims(ray);
+        const auto intr =
+            intersectWithPrims(ray, RenderStatistics::ShadowRay);
         if (l->isDelta()) {
             if (intr.hasIntersections() && intr.dist() < illumination.distance)
                 return {0, 0, 0};
@@ -63,34 +72,46 @@ private: /* Methods: */
         }
     }
 
-    Colour run(const Ray& ray, size_t depth = 1, floating iior = 1.0) {
+    /**
+     * @param weight Product of the reflection and transmission coefficients
+     * along the ray tree branch. Used for Russian roulette.
+     */
+    Colour run(const Ray& ray, size_t depth = 1, floating iior = 1.0,
+               floating weight = 1.0) {
         if (depth > RAY_MAX_REC_DEPTH) {
             return Colour{0, 0, 0};
         }
 
-        const auto intr = intersectWithPrims(ray);
+        const auto survivalPr =
+            m_scene.russianRoulette().survivalPr(depth - 1, weight);
+        if (sampler().get1D() >= survivalPr) {
+            return Colour{0, 0, 0};
+        }
+
+        m_pathLength = std::max(m_pathLength, depth);
+        const auto intr = intersectWithPrims(ray, RenderStatistics::CameraRay);
 
         if (!intr.hasIntersections()) {
-            return m_scene.background().colour();
+            return m_scene.background().colour() / survivalPr;
         } else {
-            return doLighting(ray, intr, depth, iior);
+            return doLighting(ray, intr, depth, iior, weight) / survivalPr;
         }
     }
 
-    Colour getPrimColour(const Primitive* prim, const Point& point) const {
-        const auto& m = m_scene.materials()[prim->material()];
-        if (prim->texture() >= 0) {
-            const Texture* texture = m_scene.textures()[prim->texture()];
-            return prim->getColourAtIntersection(point, texture);
+    Colour getPrimColour(const Intersection& intr) const {
+        const auto index = intr.texture();
+        if (index >= 0) {
+            const Texture* texture = m_scene.textures()[index];
+            return intr.texel(texture);
         }
 
-        return m.colour();
+        return m_scene.materials()[intr.material()].colour();
     }
 
-    Colour doLighting(const Ray& ray, const Intersection& intr, int depth,
-                      floating iior) {
+    Colour doLighting(const Ray& ray, const Intersection& intr, size_t depth,
+                      floating iior, floating weight) {
         const auto prim = intr.getPrimitive();
-        const Material& m = m_scene.materials()[prim->material()];
+        const Material& m = m_scene.materials()[intr.material()];
 
         if (prim->emissive()) {
             return prim->getLight()->intensity();
@@ -98,7 +119,7 @@ private: /* Methods: */
 
         const auto point = intr.point();
         const auto V = ray.dir();
-        const auto N = prim->normal(point);
+        const auto N = intr.normal();
         const auto internal = V.dot(N) > 0.0;
         const auto N2 = internal ? -N : N;
 
@@ -111,12 +132,13 @@ private: /* Methods: */
             const auto diff = m.kd() * clamp(L.dot(N), 0, 1);
             const auto spec =
                 m.ks() * pow(clamp(V.dot(R), 0, 1), m.phong_pow());
-            col += shade * (diff + spec) * getPrimColour(prim, point);
+            col += shade * (diff + spec) * getPrimColour(intr);
         }
 
         // reflection
         if (m.ks() > 0) {
-            col += m.ks() * run(ray.reflect(intr), depth + 1, iior);
+            col += m.ks() * run(ray.reflect(intr), depth + 1, iior,
+                                weight * m.ks());
         }
 
         // refraction
@@ -131,11 +153,14 @@ private: /* Methods: */
                 const auto T = normalised(n * V -
                                           (internal ? -1.0 : 1.0) * N *
                                               (n * cosT1 + sqrt(cosT2)));
-                col += m.t() *
-                       run(shootRay(point, T), depth + 1, internal ? n2 : n1);
+                col += m.t() * run(shootRay(point, T), depth + 1,
+                                   internal ? n2 : n1, weight * m.t());
             }
         }
 
         return col;
     }
+
+private: /* Fields: */
+    size_t m_pathLength; ///< Depth of the deepest ray of the current ray tree.
 };
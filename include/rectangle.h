@@ -1,5 +1,6 @@
 #pragma once
 
+#include "binary_io.h"
 #include "intersection.h"
 #include "primitive.h"
 #include "ray.h"
@@ -51,6 +52,13 @@ public: /* Methods: */
                               m_point[axis] + m_v[axis] + m_u[axis])));
     }
 
+    void write(BinaryWriter& out) const {
+        out.write(static_cast<uint8_t>(PrimitiveType::Rectangle));
+        out.writeVector(m_point);
+        out.writeVector(m_u);
+        out.writeVector(m_v);
+    }
+
 protected:
     const Point m_point;
     const Vector m_u, m_v, m_normal;
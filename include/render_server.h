@@ -0,0 +1,79 @@
+#pragma once
+
+#include "camera.h"
+#include "russian_roulette.h"
+
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+class Scene;
+
+/**
+ * Long running renderer that keeps scenes in memory between jobs. Clients
+ * connect to a unix domain socket and send one request per line:
+ *
+ *     render <scene> <output> [samples n] [whitted|bpt|vcm]
+ *            [v from .. at .. up .. angle .. [hither ..] [resolution ..]
+ *               [aperture ..] [focus ..]]
+ *     unload <scene>
+ *     shutdown
+ *
+ * The first render request of a scene parses it and builds its kd-tree, later
+ * requests reuse them. Without a view the camera of the scene file is used.
+ * A render request is answered by "progress <done> <total>" lines about once
+ * a second and by "done <output>" when the image has been written. Failed
+ * requests are answered by "error <reason>". Every client is served by a
+ * thread of its own, so a client that stalls does not hold up the others,
+ * but jobs are rendered one at a time on all of the rendering threads.
+ */
+class RenderServer {
+public: /* Methods: */
+
+    RenderServer(std::string socketPath, RussianRoulette russianRoulette,
+                 bool useCache);
+
+    ~RenderServer();
+
+    /// Serves clients until shut down. @retval false if binding failed.
+    bool run();
+
+private:
+
+    /// Serves requests of one client until it disconnects or the server
+    /// shuts down.
+    void serve(int fd);
+
+    void handle(int fd, const std::string& request);
+
+    void render(int fd, const std::string& request);
+
+    /// Loaded scene, @retval nullptr with the reason in @a error if the file
+    /// can not be read.
+    Scene* scene(const std::string& fname, std::string& error);
+
+private: /* Fields: */
+
+    struct LoadedScene {
+        std::unique_ptr<Scene> scene;
+        Camera::Parameters     view; ///< Camera of the scene file.
+    };
+
+    const std::string     m_socketPath;
+    const RussianRoulette m_russianRoulette;
+    const bool            m_useCache;
+
+    /// Requests are handled one at a time, this guards the loaded scenes.
+    boost::mutex                                 m_jobMutex;
+    std::unordered_map<std::string, LoadedScene> m_scenes;
+
+    boost::mutex              m_clientMutex;
+    boost::condition_variable m_clientGone;
+    std::set<int>             m_clients; ///< Sockets of connected clients.
+    int                       m_listener;
+    std::atomic<bool>         m_shutdown;
+};
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "sampler.h"
+#include "statistics.h"
+
 #include <memory>
 
 class Colour;
@@ -22,9 +25,25 @@ public: /* Methods: */
 
     const Scene& scene() const { return m_scene; }
 
+    /// Renderer takes its random numbers from @a sampler.
+    void setSampler(std::unique_ptr<Sampler> sampler) {
+        m_sampler = std::move(sampler);
+    }
+
 protected:
     virtual Colour render(Ray ray);
 
+    Sampler& sampler() const { return *m_sampler; }
+
+    void recordEyePath(size_t length) {
+        threadStatistics().addEyePath(length);
+    }
+
+    void recordLightPath(size_t length) {
+        threadStatistics().addLightPath(length);
+    }
+
 protected: /* Fields: */
-    const Scene& m_scene;
+    const Scene&             m_scene;
+    std::unique_ptr<Sampler> m_sampler;
 };
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "common.h"
+
+#include <cstddef>
+
+/**
+ * Throughput based Russian roulette.
+ * Paths that are shorter than the start depth always survive. Longer paths
+ * survive with probability proportional to the luminance of their current
+ * throughput (relative to the throughput the path started with), clamped to
+ * the range [minSurvivalPr, 1]. The surviving path has to divide its
+ * throughput by the returned probability.
+ */
+class RussianRoulette {
+public: /* Methods: */
+
+    explicit RussianRoulette(size_t   startDepth = RAY_RR_START_DEPTH,
+                             floating minSurvivalPr = RAY_RR_MIN_SURVIVAL_PR)
+        : m_startDepth{startDepth}
+        , m_minSurvivalPr{clamp(minSurvivalPr, 0, 1)}
+    {}
+
+    size_t startDepth() const { return m_startDepth; }
+    floating minSurvivalPr() const { return m_minSurvivalPr; }
+
+    /**
+     * @param depth Number of segments the path currently has.
+     * @param throughput Luminance of the path throughput relative to the
+     * initial throughput of the path.
+     * @return Probability that the path is extended by one more segment.
+     */
+    floating survivalPr(size_t depth, floating throughput) const {
+        if (depth < m_startDepth)
+            return 1.0;
+
+        return clamp(throughput, m_minSurvivalPr, 1.0);
+    }
+
+private: /* Fields: */
+    size_t   m_startDepth;
+    floating m_minSurvivalPr;
+};
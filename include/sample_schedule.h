@@ -0,0 +1,47 @@
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class Framebuffer;
+
+/**
+ * Number of samples every pixel takes in a pass of adaptive sampling. The
+ * image is split into tiles: a tile whose pixels have all converged takes no
+ * more samples, and in the other tiles a pixel takes samples in proportion
+ * to its error. Error of a pixel is the standard error of its mean, from
+ * the variance of its samples, relative to the square root of its
+ * brightness. Unlike the noise estimate of the image, which compares the
+ * even and the odd passes, it can be judged for a single pixel.
+ */
+class SampleSchedule {
+public: /* Methods: */
+
+    /// Every pixel takes a sample until the first update.
+    SampleSchedule(size_t width, size_t height, floating threshold);
+
+    SampleSchedule(const SampleSchedule&) = delete;
+    SampleSchedule& operator=(const SampleSchedule&) = delete;
+
+    size_t samples(size_t x, size_t y) const {
+        return m_samples[x * m_height + y].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Reschedules from the samples of the even and the odd passes, which
+     * must not change during the update. Passes that are being rendered
+     * read the schedule.
+     * @returns number of pixels that still take samples.
+     */
+    size_t update(const Framebuffer (&halves)[2]);
+
+private: /* Fields: */
+    const size_t                      m_width;
+    const size_t                      m_height;
+    const floating                    m_threshold;
+    std::vector<std::atomic<uint8_t>> m_samples;
+    std::vector<floating>             m_errors;
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "common.h"
+#include "geometry.h"
+#include "pcg32.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * Source of the uniform random numbers of a path. A pixel sample is started
+ * with its pixel and its index and every number taken from it is the next
+ * dimension of the sample. Low discrepancy samplers stratify every dimension
+ * over the samples of a pixel, so paths should take their dimensions in the
+ * same order.
+ *
+ * Samples are decorrelated between pixels and between streams of a pixel:
+ * pixels that take many samples in a pass take them from different streams
+ * and light paths take their dimensions from a stream of their own. Numbers
+ * only depend on the sample and the seed of the render.
+ */
+class Sampler {
+public: /* Methods: */
+
+    Sampler()
+        : m_renderSeed{0}
+        , m_index{0}
+        , m_seed{0}
+        , m_dimension{0}
+    {}
+
+    virtual ~Sampler() {}
+
+    virtual std::unique_ptr<Sampler> clone() const = 0;
+
+    /// Renders with different seeds take independent samples.
+    void setSeed(uint64_t seed) { m_renderSeed = seed; }
+
+    void startSample(size_t x, size_t y, size_t index, size_t stream = 0);
+
+    /// Restarts the dimensions of the current sample for its light path.
+    void startLightPath();
+
+    floating get1D() { return sample(m_dimension++); }
+
+    Vector2 get2D() {
+        const auto x = get1D();
+        const auto y = get1D();
+        return Vector2{x, y};
+    }
+
+protected: /* Methods: */
+
+    /// Dimension @a dimension of the current sample in [0, 1). Dimensions
+    /// are asked in order from zero.
+    virtual floating sample(size_t dimension) = 0;
+
+    uint32_t index() const { return m_index; }
+    uint64_t seed() const { return m_seed; }
+
+private: /* Fields: */
+    uint64_t m_renderSeed;
+    uint32_t m_index;
+    uint64_t m_seed; ///< Seed of the current sample.
+    size_t   m_dimension;
+};
+
+/**
+ * Independent uniform random numbers. The generator is seeded by the pixel,
+ * the stream and the index of the sample, so the numbers do not depend on
+ * which thread renders the sample.
+ */
+class RandomSampler : public Sampler {
+public: /* Methods: */
+    std::unique_ptr<Sampler> clone() const override {
+        return std::unique_ptr<Sampler>{new RandomSampler{*this}};
+    }
+
+protected: /* Methods: */
+    floating sample(size_t dimension) override;
+
+private: /* Fields: */
+    Pcg32 m_rng;
+};
+
+/**
+ * Halton sequence with randomly permuted digits (Faure), shifted randomly for
+ * every pixel (Cranley and Patterson). Dimensions past the first 256 primes
+ * are random like those of RandomSampler.
+ */
+class HaltonSampler : public Sampler {
+public: /* Methods: */
+    std::unique_ptr<Sampler> clone() const override {
+        return std::unique_ptr<Sampler>{new HaltonSampler{*this}};
+    }
+
+protected: /* Methods: */
+    floating sample(size_t dimension) override;
+
+private: /* Fields: */
+    Pcg32 m_rng; ///< Dimensions past the primes.
+};
+
+/**
+ * Owen scrambled Sobol sequence padded by taking the dimensions a group at a
+ * time from the first dimensions of the sequence. The order of the samples is
+ * shuffled for every group so that the groups are not correlated.
+ */
+class PaddedSobolSampler : public Sampler {
+protected: /* Methods: */
+    explicit PaddedSobolSampler(size_t groupSize)
+        : m_groupSize{groupSize}
+    {}
+
+    floating sample(size_t dimension) override;
+
+private: /* Fields: */
+    const size_t m_groupSize; ///< At most four.
+    floating     m_group[4];  ///< Dimensions of the current group.
+};
+
+/// Groups of four dimensions of the Sobol sequence.
+class SobolSampler : public PaddedSobolSampler {
+public: /* Methods: */
+    SobolSampler()
+        : PaddedSobolSampler{4}
+    {}
+
+    std::unique_ptr<Sampler> clone() const override {
+        return std::unique_ptr<Sampler>{new SobolSampler{*this}};
+    }
+};
+
+/**
+ * Progressive multi-jittered (0, 2) sequence. Every pair of dimensions is an
+ * Owen scrambled two dimensional Sobol sequence, which is a pmj02 sequence,
+ * so the points are generated on the fly instead of read from tables.
+ */
+class PMJ02Sampler : public PaddedSobolSampler {
+public: /* Methods: */
+    PMJ02Sampler()
+        : PaddedSobolSampler{2}
+    {}
+
+    std::unique_ptr<Sampler> clone() const override {
+        return std::unique_ptr<Sampler>{new PMJ02Sampler{*this}};
+    }
+};
+
+/// Sampler by name (random, halton, sobol or pmj02), null if unknown.
+Sampler* makeSampler(const std::string& name);
@@ -1,33 +1,51 @@
 #pragma once
 
+#include "animation.h"
 #include "camera.h"
 #include "common.h"
 #include "geometry.h"
 #include "light.h"
+#include "light_sampler.h"
 #include "material.h"
 #include "materials.h"
+#include "russian_roulette.h"
+#include "statistics.h"
 #include "surface.h"
 #include "texture.h"
 
 #include <cassert>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 class BackgroundLight;
 class Block;
+class Checkpoint;
 class Light;
 class Pixel;
 class Primitive;
 class PrimitiveManager;
+class Prototype;
 class Renderer;
+class Sampler;
 class SceneReader;
+class ThreadPool;
+class TriangleMesh;
 
 // TODO: replace background material with background light.
 
 /// Representation of scene.
 class Scene {
     friend class Block;
+    friend class SceneCache;
+
+public: /* Types: */
+
+    /// Called with the number of finished and total samples while rendering.
+    using ProgressCallback = std::function<void(size_t, size_t)>;
 
 public: /* Methods: */
     Scene();
@@ -36,7 +54,8 @@ public: /* Methods: */
 
     /**
      * Does the real raytracing.
-     * Image is generated.
+     * Image is generated. Can be run again with another camera or surfaces,
+     * the rendering threads are kept between runs.
      */
     void run();
 
@@ -45,9 +64,16 @@ public: /* Methods: */
      * Complete destruction of our spacetime will ensure
      * if this method is not called before raytracing begins.
      *
-     * @todo Throw logic exceptions from here.
+     * @retval false with the reason in @a error if the scene can not be
+     *         read, the scene is left empty then.
      */
-    void init();
+    bool init(std::string& error);
+
+    /**
+     * Poses the animated camera and instances at @a time (in frames). Scene
+     * must have been initialised.
+     */
+    void setTime(floating time);
 
     /**
      * Sets scenes primitive manager.
@@ -58,20 +84,103 @@ public: /* Methods: */
 
     void setRenderer(Renderer* r);
 
+    /// Every rendering thread takes its random numbers from a clone of
+    /// @a sampler, Sobol by default.
+    void setSampler(Sampler* sampler);
+
+    /// Renders with different seeds take independent samples.
+    void setSeed(uint64_t seed) { m_seed = seed; }
+    /**
+     * Deterministic renders give the same image regardless of the number of
+     * threads: every thread renders its passes to a framebuffer of its own
+     * and the passes are added to the image in order. Time limit and
+     * adaptive sampling make the image depend on the speed of rendering.
+     */
+    void setDeterministic(bool deterministic) {
+        m_deterministic = deterministic;
+    }
+    bool deterministic() const { return m_deterministic; }
+
+    /**
+     * Sums of the image are saved to @a checkpoint every @a interval seconds
+     * and when a run finishes. With @a resume a run continues from the saved
+     * sums if there are any. Passes are added to the image in order like in
+     * deterministic renders.
+     */
+    void setCheckpoint(Checkpoint* checkpoint, floating interval,
+                       bool resume);
+
+    /// Renders only the passes shard, shard + shards and so on of the
+    /// samples, the sums of the shards add up to the whole render.
+    void setShard(size_t shard, size_t shards) {
+        m_shard = shard;
+        m_shards = shards;
+    }
+
     void setSamples(size_t n) { m_samples = n; }
+    size_t samples() const { return m_samples; }
+    /// Rendering stops after the passes in flight once @a seconds have passed,
+    /// zero for no limit.
+    void setTimeLimit(floating seconds) { m_timeLimit = seconds; }
+    /// Rendering stops once the estimated noise of the image is at most
+    /// @a noise, zero for no target.
+    void setNoiseTarget(floating noise) { m_noiseTarget = noise; }
+    /// Pixels stop taking samples once their error is at most @a threshold,
+    /// zero samples every pixel uniformly.
+    void setAdaptiveSampling(floating threshold) {
+        m_adaptiveThreshold = threshold;
+    }
+    /// Progress is reported about once a second and when a run finishes.
+    void setProgressCallback(ProgressCallback callback) {
+        m_progressCallback = std::move(callback);
+    }
+
+    /// Counters of the last run, they are printed when it finishes.
+    const RenderStatistics& statistics() const { return m_statistics; }
+
+    void setRussianRoulette(RussianRoulette rr) { m_russianRoulette = rr; }
+    const RussianRoulette& russianRoulette() const { return m_russianRoulette; }
 
     void setSceneReader(SceneReader* sr);
 
+    /// Scene and its acceleration structure are cached in @a fname.
+    void setCacheFile(std::string fname) { m_cacheFile = std::move(fname); }
+
+    /// Notes that the scene was read from @a fname as well (a texture or a
+    /// material library), so that the cache depends on it.
+    void addDependency(std::string fname) {
+        m_dependencies.push_back(std::move(fname));
+    }
+    const std::vector<std::string>& dependencies() const {
+        return m_dependencies;
+    }
+
     void addPrimitive(const Primitive* prim);
+    void reservePrimitives(size_t n);
     void addLight(Light* light);
+    /// Scene takes ownership of the mesh shared by primitives.
+    void addMesh(TriangleMesh* mesh);
+    const std::vector<std::unique_ptr<TriangleMesh>>& meshes() const {
+        return m_meshes;
+    }
+    /// Scene takes ownership of the geometry shared by instances.
+    void addPrototype(Prototype* prototype);
+    const std::vector<std::unique_ptr<Prototype>>& prototypes() const {
+        return m_prototypes;
+    }
     const std::vector<std::unique_ptr<Light>>& lights() const;
+    const LightSampler& lightSampler() const { return m_lightSampler; }
     void attachSurface(Surface* surface) { m_surfaces.emplace_back(surface); }
+    /// Releases the surfaces, which writes the images of the last run.
+    void detachSurfaces() { m_surfaces.clear(); }
     const std::vector<std::unique_ptr<Surface>>& surfaces() const {
         return m_surfaces;
     }
     PrimitiveManager& manager() const { return *m_manager; }
     const Materials& materials() const { return m_materials; }
     Materials& materials() { return m_materials; }
+    Animation& animation() { return m_animation; }
+    const Animation& animation() const { return m_animation; }
     Camera& camera() { return m_camera; }
     const Camera& camera() const { return m_camera; }
     Renderer& renderer() { return *m_renderer; }
@@ -94,17 +203,41 @@ public: /* Methods: */
 private:
     void updatePixel(size_t x, size_t y, Colour c) const;
 
+    /// Removes everything that has been read into the scene.
+    void clear();
+
 protected: /* Fields: */
-    SceneSphere                           m_sceneSphere;
-    Camera                                m_camera;
-    Materials                             m_materials;
-    std::unique_ptr<PrimitiveManager>     m_manager;
-    std::unique_ptr<SceneReader>          m_scene_reader;
-    std::vector<std::unique_ptr<Light>>   m_lights;
-    Light*                                m_backgroundLight;
-    material_index_t                      m_background;
-    std::vector<std::unique_ptr<Surface>> m_surfaces;
-    Textures                              m_textures;
-    std::unique_ptr<Renderer>             m_renderer;
-    size_t                                m_samples;
+    SceneSphere                                m_sceneSphere;
+    Camera                                     m_camera;
+    Animation                                  m_animation;
+    Materials                                  m_materials;
+    std::unique_ptr<PrimitiveManager>          m_manager;
+    std::unique_ptr<SceneReader>               m_scene_reader;
+    std::vector<std::unique_ptr<Light>>        m_lights;
+    std::vector<std::unique_ptr<TriangleMesh>> m_meshes;
+    std::vector<std::unique_ptr<Prototype>>    m_prototypes;
+    LightSampler                               m_lightSampler;
+    Light*                                     m_backgroundLight;
+    material_index_t                           m_background;
+    std::vector<std::unique_ptr<Surface>>      m_surfaces;
+    Textures                                   m_textures;
+    std::unique_ptr<Renderer>                  m_renderer;
+    std::unique_ptr<Sampler>                   m_sampler;
+    uint64_t                                   m_seed;
+    bool                                       m_deterministic;
+    std::unique_ptr<Checkpoint>                m_checkpoint;
+    floating                                   m_checkpointInterval;
+    bool                                       m_resume;
+    size_t                                     m_shard;
+    size_t                                     m_shards;
+    size_t                                     m_samples;
+    floating                                   m_timeLimit;
+    floating                                   m_noiseTarget;
+    floating                                   m_adaptiveThreshold;
+    RussianRoulette                            m_russianRoulette;
+    std::string                                m_cacheFile;
+    std::vector<std::string>                   m_dependencies;
+    std::unique_ptr<ThreadPool>                m_threadPool;
+    ProgressCallback                           m_progressCallback;
+    RenderStatistics                           m_statistics;
 };
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class Scene;
+
+/**
+ * Binary snapshot of a parsed scene together with its acceleration
+ * structure. The cache is tagged with hashes of the source file and of the
+ * textures and material libraries that the scene was read from, and is
+ * ignored if any of them has changed since the cache was written, in which
+ * case the scene is parsed and the cache is written again.
+ *
+ * Primitives and lights are reconstructed from their shapes, the kd-tree
+ * refers to primitives by index and is not rebuilt.
+ */
+class SceneCache {
+public: /* Methods: */
+
+    SceneCache(std::string cacheFile, std::string sourceFile);
+
+    /**
+     * Loads the scene if the cache is present and up to date. Must be called
+     * on a scene into which nothing has been read yet.
+     * @retval false if the cache is missing, stale or damaged, the scene is
+     * left empty.
+     */
+    bool load(Scene& scene) const;
+
+    /// Writes the scene whose primitive manager has been initialised.
+    bool save(const Scene& scene) const;
+
+    /// Hash of the contents of @a sourceFile, zero if it can not be read.
+    static uint64_t hashSource(const std::string& sourceFile);
+
+private: /* Methods: */
+
+    /// Clears the partially loaded @a scene. @retval false always.
+    bool damaged(Scene& scene) const;
+
+private: /* Fields: */
+    const std::string m_cacheFile;
+    const std::string m_sourceFile;
+    uint64_t          m_sourceHash; ///< Zero if the source can not be read.
+};
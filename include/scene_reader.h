@@ -14,7 +14,8 @@ public: /* Methods: */
 
     virtual ~SceneReader() {}
 
-    virtual Status init(Scene& scene) const = 0;
+    /// Reads the scene, on failure @a error tells why.
+    virtual Status init(Scene& scene, std::string& error) const = 0;
 
     std::string getFname() { return m_fname; }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "binary_io.h"
 #include "common.h"
 #include "geometry.h"
 #include "intersection.h"
@@ -53,6 +54,12 @@ public: /* Methods: */
         return texture->getTexel(u, v);
     }
 
+    void write(BinaryWriter& out) const {
+        out.write(static_cast<uint8_t>(PrimitiveType::Sphere));
+        out.writeVector(m_center);
+        out.write(m_radius);
+    }
+
 protected: /* Fields: */
 
     const Point    m_center;    ///< Center of the sphere
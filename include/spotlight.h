@@ -12,10 +12,10 @@ public: /* Methods: */
         , m_position{p}
         , m_frame{d}
         , m_cosAngle{clamp(cos(a), 0, 1)}
-        , m_emissionPdfW{1.0 / (2.0 * M_PI * (1.0 - m_cosAngle))}
+        , m_emissionPdfW{uniformConePdfW(m_cosAngle)}
     {}
 
-    virtual IlluminateResult illuminate(Point pos) const override {
+    virtual IlluminateResult illuminate(Point pos, Sampler&) const override {
         Vector         direction = m_position - pos;
         const floating distSqr = direction.sqrlength();
         const floating distance = std::sqrt(distSqr);
@@ -27,14 +27,9 @@ public: /* Methods: */
         return {intensity(), direction, distance, distSqr, m_emissionPdfW, 1.0};
     }
 
-    virtual EmitResult emit() const override {
-        auto dir = Vector{0, 0, 0};
-        while (true) {
-            dir = sampleUniformHemisphere().get();
-            if (dir.z >= m_cosAngle)
-                break;
-        }
-
+    virtual EmitResult emit(Sampler& sampler) const override {
+        const auto dir =
+            m_frame.toWorld(sampleUniformCone(sampler, m_cosAngle).get());
         return {intensity(), m_position, m_frame.normal(), dir, m_emissionPdfW,
                 1.0,         1.0};
     }
@@ -43,6 +38,17 @@ public: /* Methods: */
         return {{0, 0, 0}, m_emissionPdfW, 1.0};
     }
 
+    floating power() const override {
+        return luminance(intensity()) / m_emissionPdfW;
+    }
+
+    void write(BinaryWriter& out) const override {
+        writeHeader(out, LightType::Spot);
+        out.writeVector(m_position);
+        out.writeVector(m_frame.normal());
+        out.write(std::acos(m_cosAngle));
+    }
+
 private: /* Fields: */
     const Point    m_position;
     const Frame    m_frame;
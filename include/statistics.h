@@ -0,0 +1,107 @@
+#pragma once
+
+#include "common.h"
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <iosfwd>
+
+/**
+ * Counters of the work done by a render. Every rendering thread counts into
+ * a copy of its own (see threadStatistics) without synchronization, the
+ * copies are added up when the run finishes.
+ */
+struct RenderStatistics {
+    /// Rays by what they are traced for.
+    enum RayType {
+        CameraRay,     ///< Extends a camera (eye) sub-path.
+        LightRay,      ///< Extends a light sub-path.
+        ShadowRay,     ///< Tests the visibility of a light sample.
+        ConnectionRay, ///< Tests the visibility between two path vertices.
+        NumRayTypes
+    };
+
+    /// Timed parts of a pass.
+    enum Phase {
+        LightPass,  ///< Light sub-paths traced ahead of the camera paths.
+        GridBuild,  ///< Hash grid of the light vertices of VCM.
+        CameraPass, ///< Camera paths, and light paths traced along them.
+        NumPhases
+    };
+
+    /// Paths of this many segments or more share the last bucket.
+    enum { NumPathLengths = 16 };
+
+    size_t   rays[NumRayTypes];
+    size_t   nodesVisited;     ///< Kd-tree nodes, of instances too.
+    size_t   primitivesTested; ///< Intersection tests with primitives.
+    size_t   gridQueries;      ///< Hash grid lookups.
+    size_t   gridProbes;       ///< Vertices whose distance a lookup tested.
+    size_t   flushes;          ///< Framebuffer update queue flushes.
+    size_t   flushedUpdates;   ///< Pixel updates of those flushes.
+    size_t   eyePathLengths[NumPathLengths];
+    size_t   lightPathLengths[NumPathLengths];
+    size_t   eyeSegments;
+    size_t   lightSegments;
+    floating phaseSeconds[NumPhases]; ///< Summed over the threads.
+    floating seconds;                 ///< Wall clock time of the run.
+
+    RenderStatistics();
+
+    void addRay(RayType type) { ++rays[type]; }
+
+    void addEyePath(size_t length) {
+        ++eyePathLengths[std::min<size_t>(length, NumPathLengths - 1)];
+        eyeSegments += length;
+    }
+
+    void addLightPath(size_t length) {
+        ++lightPathLengths[std::min<size_t>(length, NumPathLengths - 1)];
+        lightSegments += length;
+    }
+
+    size_t totalRays() const;
+    size_t eyePaths() const;
+    size_t lightPaths() const;
+
+    /// Millions of rays traced per second of the run.
+    floating mraysPerSecond() const;
+
+    RenderStatistics& operator+=(const RenderStatistics& other);
+
+    /// Human readable summary of a few lines.
+    void print(std::ostream& os) const;
+
+    /// Every counter as a JSON object.
+    void writeJson(std::ostream& os) const;
+};
+
+/// Statistics of the calling thread.
+RenderStatistics& threadStatistics();
+
+/// Adds the time from construction to destruction to a phase of the
+/// statistics of the calling thread.
+class PhaseTimer {
+public: /* Methods: */
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    explicit PhaseTimer(RenderStatistics::Phase phase)
+        : m_phase{phase}
+        , m_start{boost::posix_time::microsec_clock::universal_time()}
+    {}
+
+    ~PhaseTimer() {
+        const auto elapsed =
+            boost::posix_time::microsec_clock::universal_time() - m_start;
+        threadStatistics().phaseSeconds[m_phase] +=
+            elapsed.total_microseconds() * 1e-6;
+    }
+
+private: /* Fields: */
+    const RenderStatistics::Phase m_phase;
+    const boost::posix_time::ptime m_start;
+};
@@ -18,6 +18,9 @@ public: /* Methods: */
     virtual void init() = 0;
     virtual void setPixel(int, int, const Colour&) = 0;
 
+    /// Writes the image to the file, destroying the surface also writes it.
+    virtual void write() = 0;
+
 protected: /* Fields: */
     int m_height, m_width;
 };
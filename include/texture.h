@@ -4,9 +4,9 @@
 #include "common.h"
 #include "table.h"
 
-#include <vector>
+#include <deque>
 
-using texture_index_t = uint16_t;
+using texture_index_t = int16_t;
 
 class Texture : public table<Colour> {
 public: /* Methods: */
@@ -34,8 +34,10 @@ public: /* Methods: */
     }
 };
 
+// Textures do not move when new ones are registered so lights can refer to
+// them.
 class Textures {
-    using impl_t = std::vector<Texture>;
+    using impl_t = std::deque<Texture>;
 
 public: /* Methods: */
 
@@ -51,6 +53,10 @@ public: /* Methods: */
         return &m_textures[idx];
     }
 
+    size_t size() const { return m_textures.size(); }
+
+    void clear() { m_textures.clear(); }
+
 private: /* Fields: */
     impl_t m_textures;
 };
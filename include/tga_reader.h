@@ -4,4 +4,5 @@ class Texture;
 
 #include <string>
 
+/// @return empty texture if the file can not be read.
 Texture readTexture(std::string tgaFileName);
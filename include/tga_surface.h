@@ -16,6 +16,8 @@ public: /* Methods: */
 
     void init();
 
+    void write();
+
     void setPixel(int h, int w, const Colour& c) {
         data[h][w] = c.getPixel();
     }
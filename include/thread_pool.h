@@ -0,0 +1,120 @@
+#pragma once
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+/**
+ * Fixed set of worker threads that is kept alive between runs, so that a
+ * sequence of renders does not pay for thread startup every time. Every run
+ * hands the same task to all of the workers and waits until all of them are
+ * done with it.
+ */
+class ThreadPool {
+public: /* Types: */
+
+    /// Called with the index of the worker.
+    using Task = std::function<void(size_t)>;
+
+public: /* Methods: */
+
+    explicit ThreadPool(size_t size)
+        : m_size{size}
+        , m_task{nullptr}
+        , m_generation{0}
+        , m_running{0}
+        , m_stop{false}
+    {
+        for (size_t i = 0; i < m_size; ++i)
+            m_threads.create_thread([this, i]() { work(i); });
+    }
+
+    ~ThreadPool() {
+        {
+            boost::mutex::scoped_lock lock{m_mutex};
+            m_stop = true;
+        }
+
+        m_wake.notify_all();
+        m_threads.join_all();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return m_size; }
+
+    /// Runs @a task on every worker and returns when all have finished.
+    void run(const Task& task) {
+        boost::mutex::scoped_lock lock{m_mutex};
+        m_task = &task;
+        m_running = m_size;
+        ++m_generation;
+        m_wake.notify_all();
+        while (m_running > 0)
+            m_finished.wait(lock);
+        m_task = nullptr;
+    }
+
+private:
+
+    void work(size_t index) {
+        size_t seen = 0;
+        for (;;) {
+            const Task* task = nullptr;
+            {
+                boost::mutex::scoped_lock lock{m_mutex};
+                while (!m_stop && m_generation == seen)
+                    m_wake.wait(lock);
+                if (m_stop)
+                    return;
+                seen = m_generation;
+                task = m_task;
+            }
+
+            (*task)(index);
+
+            boost::mutex::scoped_lock lock{m_mutex};
+            if (--m_running == 0)
+                m_finished.notify_all();
+        }
+    }
+
+private: /* Fields: */
+    const size_t              m_size;
+    boost::thread_group       m_threads;
+    boost::mutex              m_mutex;
+    boost::condition_variable m_wake;     ///< New task or stopping.
+    boost::condition_variable m_finished; ///< Last worker is done.
+    const Task*               m_task;
+    size_t                    m_generation; ///< Number of tasks handed out.
+    size_t                    m_running;    ///< Workers still on the task.
+    bool                      m_stop;
+};
+
+/**
+ * Calls @a func for every index below @a n on all hardware threads, the
+ * calling thread included. Indices are handed out one at a time, so uneven
+ * amounts of work per index even out.
+ */
+template <typename F>
+void parallelFor(size_t n, F func) {
+    std::atomic<size_t> next{0};
+    const auto          work = [&]() {
+        for (size_t i; (i = next++) < n;) {
+            func(i);
+        }
+    };
+
+    const size_t nP = std::min<size_t>(
+        std::max(boost::thread::hardware_concurrency(), 1u), n);
+    boost::thread_group threads;
+    for (size_t i = 1; i < nP; ++i) {
+        threads.create_thread(work);
+    }
+
+    work();
+    threads.join_all();
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "common.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/**
+ * Word of the input buffer delimited by white space.
+ */
+struct Token {
+    const char* begin;
+    const char* end;
+
+    size_t size() const { return end - begin; }
+    bool empty() const { return begin == end; }
+    std::string str() const { return std::string(begin, end); }
+
+    bool operator==(const char* s) const {
+        const auto n = strlen(s);
+        return size() == n && memcmp(begin, s, n) == 0;
+    }
+
+    bool operator!=(const char* s) const { return !(*this == s); }
+};
+
+/**
+ * Splits text into white space separated words and numbers. Works directly on
+ * the input buffer, which need not be null terminated, and never allocates.
+ * Reading a number either succeeds or leaves the position unchanged so that
+ * optional trailing arguments can be tried.
+ */
+class Tokenizer {
+public: /* Methods: */
+
+    /// Line numbers are counted from @a origin, the start of the buffer.
+    Tokenizer(const char* begin, const char* end,
+              const char* origin = nullptr)
+        : m_begin{origin != nullptr ? origin : begin}
+        , m_cur{begin}
+        , m_end{end}
+    {}
+
+    bool atEnd() {
+        skipSpace();
+        return m_cur == m_end;
+    }
+
+    const char* position() const { return m_cur; }
+
+    /// Line number of the current position, takes linear time.
+    size_t line() const { return 1 + std::count(m_begin, m_cur, '\n'); }
+
+    /// Next non-space character without consuming it, zero at the end.
+    char peek() {
+        skipSpace();
+        return m_cur == m_end ? '\0' : *m_cur;
+    }
+
+    Token word() {
+        skipSpace();
+        const auto start = m_cur;
+        while (m_cur != m_end && !isSpace(*m_cur))
+            ++m_cur;
+        return {start, m_cur};
+    }
+
+    /// Consumes the next word only if it is @a s.
+    bool accept(const char* s) {
+        const auto save = m_cur;
+        if (word() == s)
+            return true;
+
+        m_cur = save;
+        return false;
+    }
+
+    /// Consumes @a c only if it is the very next character.
+    bool acceptChar(char c) {
+        if (m_cur == m_end || *m_cur != c)
+            return false;
+
+        ++m_cur;
+        return true;
+    }
+
+    /// True if only blanks or a comment remain on the current line.
+    bool atLineEnd() {
+        while (m_cur != m_end && (*m_cur == ' ' || *m_cur == '\t'))
+            ++m_cur;
+        return m_cur == m_end || *m_cur == '\n' || *m_cur == '\r' ||
+               *m_cur == '#';
+    }
+
+    void skipLine() {
+        const auto nl = memchr(m_cur, '\n', m_end - m_cur);
+        m_cur = nl != nullptr ? static_cast<const char*>(nl) + 1 : m_end;
+    }
+
+    bool number(floating& out) {
+        skipSpace();
+        auto p = m_cur;
+        if (!parseFloating(p, out))
+            return false;
+
+        m_cur = p;
+        return true;
+    }
+
+    bool number(int& out) {
+        skipSpace();
+        auto       p = m_cur;
+        const bool neg = p != m_end && *p == '-';
+        if (p != m_end && (*p == '-' || *p == '+'))
+            ++p;
+
+        if (p == m_end || !isDigit(*p))
+            return false;
+
+        long value = 0;
+        while (p != m_end && isDigit(*p))
+            value = value * 10 + (*p++ - '0');
+
+        out = (int)(neg ? -value : value);
+        m_cur = p;
+        return true;
+    }
+
+    /// Reads exactly @a n numbers or none at all.
+    template <typename T>
+    bool numbers(T* out, size_t n) {
+        const auto save = m_cur;
+        for (size_t i = 0; i < n; ++i) {
+            if (!number(out[i])) {
+                m_cur = save;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+private: /* Methods: */
+
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' ||
+               c == '\v';
+    }
+
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    void skipSpace() {
+        while (m_cur != m_end && isSpace(*m_cur))
+            ++m_cur;
+    }
+
+    /**
+     * Decimal floating point number. Up to 19 significant digits are
+     * accumulated to an integer which is scaled by an exactly representable
+     * power of ten. The result is correctly rounded if the mantissa fits into
+     * 53 bits and the exponent is small, otherwise falls back to strtod.
+     */
+    bool parseFloating(const char*& p, floating& out) const {
+        static const double powers[] = {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+            1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+            1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+        const auto start = p;
+        bool       neg = false;
+        if (p != m_end && (*p == '-' || *p == '+'))
+            neg = *p++ == '-';
+
+        uint64_t mantissa = 0;
+        int      digits = 0, exponent = 0;
+        bool     any = false, truncated = false;
+        for (; p != m_end && isDigit(*p); ++p) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+            } else {
+                truncated = true;
+                ++exponent;
+            }
+        }
+
+        if (p != m_end && *p == '.') {
+            for (++p; p != m_end && isDigit(*p); ++p) {
+                any = true;
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    digits += mantissa != 0;
+                    --exponent;
+                } else {
+                    truncated = true;
+                }
+            }
+        }
+
+        if (!any) {
+            p = start;
+            return false;
+        }
+
+        if (p != m_end && (*p == 'e' || *p == 'E')) {
+            auto       q = p + 1;
+            const bool negExp = q != m_end && *q == '-';
+            if (q != m_end && (*q == '-' || *q == '+'))
+                ++q;
+
+            if (q != m_end && isDigit(*q)) {
+                int e = 0;
+                for (; q != m_end && isDigit(*q); ++q)
+                    e = std::min(e * 10 + (*q - '0'), 100000);
+                exponent += negExp ? -e : e;
+                p = q;
+            }
+        }
+
+        if (!truncated && mantissa < (uint64_t{1} << 53) && exponent >= -22 &&
+            exponent <= 22) {
+            double value = (double)mantissa;
+            value = exponent < 0 ? value / powers[-exponent]
+                                 : value * powers[exponent];
+            out = neg ? -value : value;
+            return true;
+        }
+
+        out = strtod(std::string(start, p).c_str(), nullptr);
+        return true;
+    }
+
+private: /* Fields: */
+    const char* const m_begin;
+    const char*       m_cur;
+    const char* const m_end;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "geometry.h"
+#include "light.h"
+#include "random.h"
+
+#include <cassert>
+
+/**
+ * Single emissive triangle. Like the rectangular area light it only emits on
+ * the side the normal (p1 - p0) x (p2 - p0) points to. Larger meshes are made
+ * of many such lights and as lights are picked proportionally to power the
+ * emissive triangles of a mesh get sampled proportionally to their area.
+ */
+class TriangleLight : public Light {
+public: /* Methods: */
+
+    TriangleLight(const SceneSphere& sceneSphere, Colour intensity, Point p0,
+                  Point p1, Point p2)
+        : Light{sceneSphere, intensity, true, false}
+        , m_point{p0}
+        , m_e1{p1 - p0}
+        , m_e2{p2 - p0}
+    {
+        auto normal = m_e1.cross(m_e2);
+        const auto len = normal.length(); // twice the area
+        assert(len > 0.0);
+        normal = normal / len;
+        m_frame = Frame::fromNormalised(normal);
+        m_invArea = 2.0 / len;
+    }
+
+    /// Emitters without area have no normal and an infinite density, scene
+    /// readers drop them.
+    static bool hasArea(Point p0, Point p1, Point p2) {
+        return (p1 - p0).cross(p2 - p0).length() > 0.0;
+    }
+
+    IlluminateResult illuminate(Point pos, Sampler& sampler) const override {
+        const auto pointOnTriangle = samplePoint(sampler);
+        auto       direction = pointOnTriangle - pos;
+        const auto distSqr = direction.sqrlength();
+        const auto distance = std::sqrt(distSqr);
+        direction = direction / distance;
+        const auto cosNormal = m_frame.normal().dot(-direction);
+
+        if (cosNormal < epsilon)
+            return {};
+
+        const auto directPdfW = m_invArea * distSqr / cosNormal;
+        const auto emissionPdfW = m_invArea * cosNormal * RAY_INV_PI;
+        return {intensity(), direction,    distance,
+                directPdfW,  emissionPdfW, cosNormal};
+    }
+
+    EmitResult emit(Sampler& sampler) const override {
+        auto localDir = sampleCosHemisphere(sampler).get();
+        while (localDir.z < epsilon) // try again if angle is too steep
+            localDir = sampleCosHemisphere(sampler).get();
+
+        const auto cosTheta = localDir.z;
+
+        const auto pointOnTriangle = samplePoint(sampler);
+        const auto direction = m_frame.toWorld(localDir);
+        const auto emissionPdfW = m_invArea * localCosHemispherePdfW(localDir);
+        const auto directPdfA = m_invArea;
+        return {cosTheta * intensity(),
+                pointOnTriangle,
+                m_frame.normal(),
+                direction,
+                emissionPdfW,
+                directPdfA,
+                cosTheta};
+    }
+
+    RadianceResult radiance(Point, Vector dir) const override {
+        const auto cosNormal = m_frame.normal().dot(-dir);
+        if (cosNormal <= 0.0)
+            return {};
+
+        return {intensity(), m_invArea * cosNormal * RAY_INV_PI, m_invArea};
+    }
+
+    floating power() const override {
+        return luminance(intensity()) * RAY_PI / m_invArea;
+    }
+
+    void write(BinaryWriter& out) const override {
+        writeHeader(out, LightType::Triangle);
+        out.writeVector(m_point);
+        out.writeVector(m_point + m_e1);
+        out.writeVector(m_point + m_e2);
+    }
+
+private: /* Methods: */
+
+    Point samplePoint(Sampler& sampler) const {
+        const auto uv = sampleUniformTriangle(sampler);
+        return m_point + uv.x * m_e1 + uv.y * m_e2;
+    }
+
+private: /* Fields: */
+    const Point  m_point;
+    const Vector m_e1;
+    const Vector m_e2;
+    Frame        m_frame;
+    floating     m_invArea;
+};
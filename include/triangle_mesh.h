@@ -0,0 +1,214 @@
+#pragma once
+
+#include "binary_io.h"
+#include "geometry.h"
+#include "intersection.h"
+#include "primitive.h"
+#include "ray.h"
+#include "texture.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Vertex buffers shared by the triangles of a mesh. Every vertex has a
+ * position and, if the mesh has them, a normal and uv-coordinates. Identical
+ * vertices are stored once, triangles refer to them by 32-bit indices.
+ */
+class TriangleMesh {
+private: /* Types: */
+
+    struct VertexKey {
+        floating values[8];
+
+        bool operator==(const VertexKey& other) const {
+            return memcmp(values, other.values, sizeof(values)) == 0;
+        }
+    };
+
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey& key) const;
+    };
+
+    using Lookup = std::unordered_map<VertexKey, uint32_t, VertexKeyHash>;
+
+public: /* Methods: */
+
+    TriangleMesh(bool hasNormals, bool hasUVs)
+        : m_hasNormals{hasNormals}
+        , m_hasUVs{hasUVs}
+        , m_index{0}
+    {}
+
+    bool hasNormals() const { return m_hasNormals; }
+    bool hasUVs() const { return m_hasUVs; }
+
+    size_t vertexCount() const { return m_positions.size(); }
+
+    /// Position of the mesh in the scene, the cache refers to meshes by it.
+    uint32_t index() const { return m_index; }
+    void setIndex(uint32_t index) { m_index = index; }
+
+    /**
+     * Adds a vertex unless an identical one exists. Normal and uv-coordinates
+     * are ignored if the mesh does not have them.
+     * @retval Index of the vertex.
+     */
+    uint32_t addVertex(Point pos, Vector normal = Vector{0, 0, 0},
+                       Vector2 uv = Vector2{0, 0});
+
+    /**
+     * Takes over vertex buffers of equal length instead of adding the
+     * vertices one by one. Normals and uv-coordinates are dropped if the
+     * mesh does not have them.
+     */
+    void assign(std::vector<Point> positions, std::vector<Vector> normals,
+                std::vector<Vector2> uvs);
+
+    /// Releases the lookup of shared vertices and the excess capacity.
+    void finish();
+
+    const Point& position(uint32_t i) const { return m_positions[i]; }
+    const Vector& normal(uint32_t i) const { return m_normals[i]; }
+    const Vector2& uv(uint32_t i) const { return m_uvs[i]; }
+
+    void write(BinaryWriter& out) const;
+
+    /// Reads the buffers written by write(). @retval false if data is invalid.
+    bool read(BinaryReader& in);
+
+private: /* Fields: */
+    const bool            m_hasNormals;
+    const bool            m_hasUVs;
+    uint32_t              m_index;
+    std::vector<Point>    m_positions;
+    std::vector<Vector>   m_normals;
+    std::vector<Vector2>  m_uvs;
+    Lookup                m_lookup; ///< Only used while adding vertices.
+};
+
+/**
+ * Face of a triangle mesh. Keeps only the indices of its vertices, everything
+ * else is derived from the vertex buffers of the mesh when needed, so that
+ * large meshes take little memory per triangle. Rays are intersected with
+ * the Moeller-Trumbore test.
+ */
+class MeshTriangle : public Primitive {
+public: /* Methods: */
+
+    /// The vertices must have been added to the mesh.
+    MeshTriangle(const TriangleMesh& mesh, uint32_t v0, uint32_t v1,
+                 uint32_t v2)
+        : m_mesh(&mesh)
+        , m_vertices{v0, v1, v2}
+    {}
+
+    const TriangleMesh& mesh() const { return *m_mesh; }
+
+    /// Index of the vertex @a i of the triangle in the mesh.
+    uint32_t vertexIndex(size_t i) const { return m_vertices[i]; }
+
+    const Point& vertex(size_t i) const {
+        return m_mesh->position(m_vertices[i]);
+    }
+
+    void intersect(const Ray& ray, Intersection& intr) const override {
+        const auto& A = vertex(0);
+        const auto  edge1 = vertex(1) - A;
+        const auto  edge2 = vertex(2) - A;
+        const auto  D = ray.dir();
+        const auto  pvec = D.cross(edge2);
+        const auto  det = edge1.dot(pvec);
+        if (det == 0.0)
+            return;
+
+        const auto invDet = 1.0 / det;
+        const auto tvec = ray.origin() - A;
+        const auto u = tvec.dot(pvec) * invDet;
+        if (u < 0.0 || u > 1.0)
+            return;
+
+        const auto qvec = tvec.cross(edge1);
+        const auto v = D.dot(qvec) * invDet;
+        if (v < 0.0 || u + v > 1.0)
+            return;
+
+        intr.update(ray, this, edge2.dot(qvec) * invDet);
+    }
+
+    Vector normal(const Point& pos) const override {
+        if (!m_mesh->hasNormals()) {
+            const auto& p0 = vertex(0);
+            return normalised((vertex(1) - p0).cross(vertex(2) - p0));
+        }
+
+        floating u, v;
+        barycentrics(pos, u, v);
+        const auto& n0 = m_mesh->normal(m_vertices[0]);
+        return normalised(n0 + u * (m_mesh->normal(m_vertices[1]) - n0) +
+                          v * (m_mesh->normal(m_vertices[2]) - n0));
+    }
+
+    floating getLeftExtreme(size_t axis) const override {
+        return fmin(fmin(vertex(0)[axis], vertex(1)[axis]), vertex(2)[axis]);
+    }
+
+    floating getRightExtreme(size_t axis) const override {
+        return fmax(fmax(vertex(0)[axis], vertex(1)[axis]), vertex(2)[axis]);
+    }
+
+    const Colour
+    getColourAtIntersection(const Point&   pos,
+                            const Texture* texture) const override {
+        if (!m_mesh->hasUVs())
+            return texture->getTexel(0.0, 0.0);
+
+        floating u, v;
+        barycentrics(pos, u, v);
+        const auto& t0 = m_mesh->uv(m_vertices[0]);
+        const auto& t1 = m_mesh->uv(m_vertices[1]);
+        const auto& t2 = m_mesh->uv(m_vertices[2]);
+        return texture->getTexel(t0.x + u * (t1.x - t0.x) + v * (t2.x - t0.x),
+                                 t0.y + u * (t1.y - t0.y) + v * (t2.y - t0.y));
+    }
+
+    /// Writes the index of the mesh and the vertices, the mesh is cached
+    /// apart.
+    void write(BinaryWriter& out) const override {
+        out.write(static_cast<uint8_t>(PrimitiveType::MeshTriangle));
+        out.write(m_mesh->index());
+        for (auto vertex : m_vertices)
+            out.write(vertex);
+    }
+
+private: /* Methods: */
+
+    /// Weights of the second and the third vertex at @a pos, solved in the
+    /// plane of the two axes along which the triangle is largest.
+    void barycentrics(const Point& pos, floating& u, floating& v) const {
+        const auto& A = vertex(0);
+        const auto  c = vertex(1) - A;
+        const auto  b = vertex(2) - A;
+        const auto  N = b.cross(c);
+        int         k;
+        if (fabs(N[0]) > fabs(N[1])) {
+            k = (fabs(N[0]) > fabs(N[2]) ? 0 : 2);
+        } else {
+            k = (fabs(N[1]) > fabs(N[2]) ? 1 : 2);
+        }
+
+        const int      ku = (k + 1) % 3, kv = (k + 2) % 3;
+        const floating reci = 1.0 / N[k];
+        const floating hu = pos[ku] - A[ku];
+        const floating hv = pos[kv] - A[kv];
+        u = (hv * b[ku] - hu * b[kv]) * reci;
+        v = (hu * c[kv] - hv * c[ku]) * reci;
+    }
+
+private: /* Fields: */
+    const TriangleMesh* m_mesh;
+    uint32_t            m_vertices[3];
+};
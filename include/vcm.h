@@ -32,6 +32,7 @@ private: /* Types: */
         Colour   throughput;
         bool     isFinite;
         uint16_t length;
+        floating rrScale; // inverse luminance of the initial throughput
 
         floating dVCM;
         floating dVC;
@@ -116,7 +117,9 @@ private: /* Methods: */
     VCMRenderer& operator=(const VCMRenderer&) = delete;
     VCMRenderer(const VCMRenderer&) = delete;
 
-    Intersection intersectWithPrims(const Ray& ray) const {
+    Intersection intersectWithPrims(const Ray& ray,
+                                    RenderStatistics::RayType type) const {
+        threadStatistics().addRay(type);
         return m_scene.manager().intersectWithPrims(ray);
     }
 
@@ -131,15 +134,23 @@ private: /* Methods: */
 
 public: /* Methods: */
 
-    explicit VCMRenderer(const Scene& s)
+    /**
+     * @param lightVertexConnections If non-zero then instead of connecting
+     * each camera vertex to every vertex of a single light path we connect it
+     * to the given number of vertices picked randomly from the pool of all
+     * light vertices of the current iteration (light vertex cache).
+     */
+    explicit VCMRenderer(const Scene& s, size_t lightVertexConnections = 0)
         : Renderer{s}
         , m_misVmWeightFactor{0.0}
         , m_misVcWeightFactor{0.0}
         , m_lightSubpathCount{1.0}
+        , m_lightVertexConnections{lightVertexConnections}
     { }
 
     std::unique_ptr<Renderer> clone() const override final {
-        return std::unique_ptr<Renderer>{new VCMRenderer{m_scene}};
+        return std::unique_ptr<Renderer>{
+            new VCMRenderer{m_scene, m_lightVertexConnections}};
     }
 
     void render(Framebuffer& buf, size_t iter) override final {
@@ -161,10 +172,20 @@ public: /* Methods: */
         // Clear current vertices:
         m_currentVertices.clear();
 
-        // We might have to initialize some vertices:
+        // Vertices of the previous iteration are traced again if this
+        // renderer did not trace them, and always in deterministic renders.
+        // The first iteration takes them from a stream of its own:
+        if (scene().deterministic())
+            m_previousVertices.clear();
+
         if (m_previousVertices.empty()) {
+            const PhaseTimer timer{RenderStatistics::LightPass};
+            const auto       previous = iter > 0 ? iter - 1 : iter;
+            const auto       stream = iter > 0 ? 0 : 1;
             for (size_t x = 0; x < buf.width(); ++x) {
                 for (size_t y = 0; y < buf.height(); ++y) {
+                    sampler().startSample(x, y, previous, stream);
+                    sampler().startLightPath();
                     generateLightPath(buf, false);
                     for (const auto& lightVertex : m_lightPath)
                         m_previousVertices.emplace_back(lightVertex);
@@ -173,24 +194,54 @@ public: /* Methods: */
         }
 
         // Build hash grid of vertices of previous frame:
-        const auto numCells = buf.width() * buf.height();
-        m_hashGrid.build(m_previousVertices.begin(), m_previousVertices.end(),
-                         numCells, radius);
+        {
+            const PhaseTimer timer{RenderStatistics::GridBuild};
+            const auto       numCells = buf.width() * buf.height();
+            m_hashGrid.build(m_previousVertices.begin(),
+                             m_previousVertices.end(), numCells, radius);
+        }
+
+        // With light vertex cache all light paths of the iteration are traced
+        // before any of the camera paths:
+        m_lightVertexPool.clear();
+        if (useLightVertexCache()) {
+            const PhaseTimer timer{RenderStatistics::LightPass};
+            const size_t     numLightPaths = buf.width() * buf.height();
+            for (size_t i = 0; i < numLightPaths; ++i) {
+                sampler().startSample(i / buf.height(), i % buf.height(), iter);
+                sampler().startLightPath();
+                generateLightPath(buf, true);
+                for (const auto& lightVertex : m_lightPath) {
+                    m_currentVertices.emplace_back(lightVertex);
+                    m_lightVertexPool.push_back(lightVertex);
+                }
+            }
+        }
 
-        // Generate all camera paths:
+        // Generate all camera paths. Every pixel traces a light path even if
+        // adaptive sampling takes no camera samples from it, the light
+        // subpath count is fixed.
+        const PhaseTimer timer{RenderStatistics::CameraPass};
         for (size_t x = 0; x < buf.width(); ++x) {
             for (size_t y = 0; y < buf.height(); ++y) {
                 // Generate and store a single light path:
-                generateLightPath(buf, true);
-                for (const auto& lightVertex : m_lightPath)
-                    m_currentVertices.emplace_back(lightVertex);
+                if (!useLightVertexCache()) {
+                    sampler().startSample(x, y, iter);
+                    sampler().startLightPath();
+                    generateLightPath(buf, true);
+                    for (const auto& lightVertex : m_lightPath)
+                        m_currentVertices.emplace_back(lightVertex);
+                }
 
-                // Generate a single camera path:
-                const auto dx = rng();
-                const auto dy = rng();
-                const auto ray = camera.spawnRay(x + dx, y + dy);
-                const auto col = generateCameraPath(buf, ray);
-                buf.addColour(x, y, col);
+                // Generate the camera paths of the pixel:
+                for (size_t i = buf.samples(x, y); i > 0; --i) {
+                    sampler().startSample(x, y, iter, i - 1);
+                    const auto d = sampler().get2D();
+                    const auto ray =
+                        camera.spawnRay(x + d.x, y + d.y, sampler());
+                    const auto col = generateCameraPath(buf, ray);
+                    buf.addSample(x, y, col);
+                }
             }
         }
 
@@ -207,14 +258,14 @@ private: /* Methods: */
         for (;; ++lightState.length) {
             const auto ray =
                 shootRay(lightState.hitpoint, lightState.direction);
-            const auto intr = intersectWithPrims(ray);
+            const auto intr =
+                intersectWithPrims(ray, RenderStatistics::LightRay);
             if (!intr.hasIntersections())
                 break;
 
-            const auto      prim = intr.getPrimitive();
-            const Material& m = m_scene.materials()[prim->material()];
+            const Material& m = m_scene.materials()[intr.material()];
             const auto      hitpoint = intr.point();
-            const auto      lightBrdf = BRDF{ray, prim->normal(hitpoint), m};
+            const auto      lightBrdf = BRDF{ray, intr.normal(), m};
 
             if (!lightBrdf.isValid())
                 break;
@@ -247,6 +298,8 @@ private: /* Methods: */
             if (!sampleLightScattering(lightBrdf, hitpoint, lightState))
                 break;
         }
+
+        recordLightPath(lightState.length);
     }
 
     // render a single camera path
@@ -260,7 +313,8 @@ private: /* Methods: */
         for (;; ++cameraState.length) {
             const auto ray =
                 shootRay(cameraState.hitpoint, cameraState.direction);
-            const auto intr = intersectWithPrims(ray);
+            const auto intr =
+                intersectWithPrims(ray, RenderStatistics::CameraRay);
             if (!intr.hasIntersections()) {
                 if (scene().backgroundLight() &&
                     cameraState.length >= MIN_PATH_LENGTH) {
@@ -274,10 +328,10 @@ private: /* Methods: */
             }
 
             const auto      prim = intr.getPrimitive();
-            const Material& m = m_scene.materials()[prim->material()];
+            const Material& m = m_scene.materials()[intr.material()];
             const auto      hitpoint = intr.point();
             // path.push_back (hitpoint);
-            const auto cameraBrdf = BRDF{ray, prim->normal(hitpoint), m};
+            const auto cameraBrdf = BRDF{ray, intr.normal(), m};
 
             if (!cameraBrdf.isValid())
                 break;
@@ -315,7 +369,11 @@ private: /* Methods: */
             }
 
             // Connect to light vertices
-            if (!cameraBrdf.isDelta()) {
+            if (!cameraBrdf.isDelta() && useLightVertexCache()) {
+                colour += cameraState.throughput *
+                          connectToLightVertexCache(cameraBrdf, hitpoint,
+                                                    cameraState);
+            } else if (!cameraBrdf.isDelta()) {
                 for (const auto& lightVertex : m_lightPath) {
                     const size_t pathLength =
                         lightVertex.length + 1 + cameraState.length;
@@ -373,6 +431,7 @@ private: /* Methods: */
                 break;
         }
 
+        recordEyePath(cameraState.length);
         return colour;
     }
 
@@ -403,21 +462,13 @@ private: /* Methods: */
     static inline floating mis(floating x) { return x; }
 
     Light* pickLight() const {
-        floating acc = 0.0;
-        for (const auto& l : m_scene.lights()) {
-            acc += l->samplingPr();
-            if (rng() <= acc) {
-                return l.get();
-            }
-        }
-
-        return nullptr;
+        return m_scene.lightSampler().pick(sampler().get1D());
     }
 
     PathState generateLightSample() const {
         Light* light = pickLight();
 
-        const auto e = light->emit();
+        const auto e = light->emit(sampler());
         const auto emissionPdfW = e.emissionPdfW * light->samplingPr();
         const auto directPdfW = e.directPdfA * light->samplingPr();
 
@@ -426,6 +477,7 @@ private: /* Methods: */
         st.direction = e.direction;
         st.throughput = e.energy / emissionPdfW;
         st.length = 1;
+        st.rrScale = 1.0 / std::max(luminance(st.throughput), epsilon);
         st.isFinite = light->isFinite();
         st.dVCM = mis(directPdfW / emissionPdfW);
         st.dVC = light->isDelta() ? 0.0 : mis(e.cosTheta / emissionPdfW);
@@ -447,6 +499,7 @@ private: /* Methods: */
         st.direction = ray.dir();
         st.throughput = Colour{1, 1, 1};
         st.length = 1;
+        st.rrScale = 1.0;
         st.isFinite = true;
         st.dVCM = mis(m_lightSubpathCount / cameraPdfW);
         st.dVC = 0.0;
@@ -513,17 +566,52 @@ private: /* Methods: */
 
         const auto contrib =
             misWeight * geometryTerm * camEv.colour * lightEv.colour;
-        if (contrib.isZero() || occluded(hitpoint, direction, distance))
+        if (contrib.isZero() ||
+            occluded(hitpoint, direction, distance,
+                     RenderStatistics::ConnectionRay))
             return {0, 0, 0};
 
         return contrib;
     }
 
+    bool useLightVertexCache() const { return m_lightVertexConnections > 0; }
+
+    // Connect eye vertex to randomly picked vertices of the light vertex cache.
+    // The pool holds vertices of m_lightSubpathCount light paths so every pick
+    // is scaled by poolSize / m_lightSubpathCount to estimate the contribution
+    // of a single light path. MIS weights are unchanged as the expected number
+    // of connections per camera vertex remains the same.
+    Colour connectToLightVertexCache(const BRDF& cameraBrdf, Point hitpoint,
+                                     const PathState& cameraState) const {
+        const auto poolSize = m_lightVertexPool.size();
+        if (poolSize == 0)
+            return {0, 0, 0};
+
+        auto contrib = Colour{0, 0, 0};
+        for (size_t i = 0; i < m_lightVertexConnections; ++i) {
+            const auto  pick = size_t(sampler().get1D() * poolSize);
+            const auto& lightVertex =
+                m_lightVertexPool[std::min(pick, poolSize - 1)];
+            const size_t pathLength =
+                lightVertex.length + 1 + cameraState.length;
+            if (pathLength < MIN_PATH_LENGTH || pathLength > MAX_PATH_LENGTH)
+                continue;
+
+            contrib += lightVertex.throughput *
+                       connectVertices(lightVertex, cameraBrdf, hitpoint,
+                                       cameraState);
+        }
+
+        const auto scale =
+            poolSize / (m_lightSubpathCount * m_lightVertexConnections);
+        return scale * contrib;
+    }
+
     Colour directIllumination(const PathState& cameraState, Point hitpoint,
                               const BRDF& cameraBrdf) const {
         const auto light = pickLight();
         const auto lightPickPr = light->samplingPr();
-        const auto i = light->illuminate(hitpoint);
+        const auto i = light->illuminate(hitpoint, sampler());
         if (i.radiance.isZero())
             return {0, 0, 0};
 
@@ -545,7 +633,9 @@ private: /* Methods: */
         const auto contrib =
             (misWeight * camEv.cosTheta / (lightPickPr * i.directPdfW)) *
             (i.radiance * camEv.colour);
-        if (contrib.isZero() || occluded(hitpoint, i.direction, i.distance))
+        if (contrib.isZero() ||
+            occluded(hitpoint, i.direction, i.distance,
+                     RenderStatistics::ShadowRay))
             return {0, 0, 0};
 
         return contrib;
@@ -555,11 +645,12 @@ private: /* Methods: */
     void connectToCamera(Framebuffer& buf, const PathState& lightState,
                          Point hitpoint, const BRDF& lightBrdf) const {
         const auto& camera = m_scene.camera();
+        const auto  lensPoint = camera.sampleLens(sampler());
         floating    x, y;
-        if (!camera.raster(hitpoint, x, y))
+        if (!camera.raster(hitpoint, lensPoint, x, y))
             return;
 
-        auto       directionToCamera = camera.eye() - hitpoint;
+        auto       directionToCamera = lensPoint - hitpoint;
         const auto sqrDist = directionToCamera.sqrlength();
         const auto distance = std::sqrt(sqrDist);
         directionToCamera /= distance;
@@ -589,7 +680,9 @@ private: /* Methods: */
                              lightEv.colour /
                              (m_lightSubpathCount * surfaceToImageFactor);
 
-        if (contrib.isZero() || occluded(hitpoint, directionToCamera, distance))
+        if (contrib.isZero() ||
+            occluded(hitpoint, directionToCamera, distance,
+                     RenderStatistics::ConnectionRay))
             return;
 
         buf.addColour(x, y, contrib);
@@ -610,12 +703,18 @@ private: /* Methods: */
     bool sampleScattering(const BRDF& brdf, Point hitpoint, bool lightTracing,
                           PathState& state) const
     {
-        const auto sample = brdf.sample(lightTracing);
+        const auto sample = brdf.sample(lightTracing, sampler());
         if (sample.event == BRDF::NONE || sample.colour.isZero())
             return false;
 
+        // The continuation probability of the BRDF only enters the MIS
+        // weights, the path is terminated by throughput based roulette.
         const auto contPr = brdf.continuationPr();
-        if (rng() > contPr)
+        const auto throughput =
+            state.throughput * sample.colour * (sample.cosTheta / sample.dirPdfW);
+        const auto survivalPr = m_scene.russianRoulette().survivalPr(
+            state.length, luminance(throughput) * state.rrScale);
+        if (sampler().get1D() >= survivalPr)
             return false;
 
         const auto isSpecularEvent =
@@ -646,13 +745,14 @@ private: /* Methods: */
 
         state.hitpoint = hitpoint;
         state.direction = sample.direction;
-        state.throughput *= sample.colour * (sample.cosTheta / brdfDirPdfW);
+        state.throughput = throughput / survivalPr;
         return true;
     }
 
-    inline bool occluded(Point pos, Vector dir, floating dist) const {
+    inline bool occluded(Point pos, Vector dir, floating dist,
+                         RenderStatistics::RayType type) const {
         const auto ray = shootRay(pos, dir);
-        const auto intr = intersectWithPrims(ray);
+        const auto intr = intersectWithPrims(ray, type);
         // tolerance to avoid self intersections...
         // TODO think if this is actually correct...
         const auto tolerance = 2 * ray_epsilon;
@@ -672,8 +772,10 @@ private: /* Fields: */
     HashGrid            m_hashGrid;
     StoredVertices      m_currentVertices;
     std::vector<Vertex> m_lightPath;
+    std::vector<Vertex> m_lightVertexPool; ///< Light vertex cache.
     floating            m_misVmWeightFactor;
     floating            m_misVcWeightFactor;
     floating            m_lightSubpathCount;
     floating            m_vmNormalization;
+    const size_t        m_lightVertexConnections;
 };
@@ -0,0 +1,209 @@
+#include "animation.h"
+
+#include "camera.h"
+#include "instance.h"
+#include "primitive_manager.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace /* anonymous */ {
+
+/**
+ * Finds the keys around @a time. @a i is the index of the last key at or
+ * before @a time and @a s the position between it and the next key.
+ */
+template <typename Key>
+void keyInterval(const std::vector<Key>& keys, floating time, size_t& i,
+                 floating& s) {
+    const auto next = std::upper_bound(
+        keys.begin(), keys.end(), time,
+        [](floating t, const Key& key) { return t < key.time; });
+    s = 0.0;
+    if (next == keys.begin()) {
+        i = 0;
+        return;
+    }
+
+    i = next - keys.begin() - 1;
+    if (next != keys.end())
+        s = (time - keys[i].time) / (next->time - keys[i].time);
+}
+
+floating lerp(floating a, floating b, floating s) { return a + s * (b - a); }
+
+Vector lerp(const Vector& a, const Vector& b, floating s) {
+    return a + s * (b - a);
+}
+
+/// Spherical interpolation of unit vectors, also used for quaternions.
+Vector slerp(const Vector& a, const Vector& b, floating s) {
+    const auto cosTheta = clamp(a.dot(b), -1.0, 1.0);
+    const auto theta = acos(cosTheta);
+    const auto sinTheta = sin(theta);
+    if (sinTheta < 1e-6) {
+        if (cosTheta > 0.0)
+            return normalised(lerp(a, b, s));
+
+        // Opposite directions, turn around any orthogonal axis.
+        return cos(s * M_PI) * a + sin(s * M_PI) * pickOrthogonal(a);
+    }
+
+    return (sin((1.0 - s) * theta) / sinTheta) * a +
+           (sin(s * theta) / sinTheta) * b;
+}
+
+Matrix lerp(const Matrix& a, const Matrix& b, floating s) {
+    Matrix result;
+    for (size_t i = 0; i < 16; ++i)
+        result[i] = lerp(a[i], b[i], s);
+    return result;
+}
+
+Matrix linearPart(const Matrix& m) {
+    auto result = m;
+    result(0, 3) = result(1, 3) = result(2, 3) = 0.0;
+    return result;
+}
+
+/// Splits the linear part of @a m into rotation @a R and stretch @a S.
+void polarDecompose(const Matrix& m, Matrix& R, Matrix& S) {
+    const auto A = linearPart(m);
+    R = A;
+    for (int iter = 0; iter < 32; ++iter) {
+        const auto next = lerp(R, transpose(invert(R)), 0.5);
+        floating   change = 0.0;
+        for (size_t i = 0; i < 16; ++i)
+            change = std::max(change, fabs(next[i] - R[i]));
+        R = next;
+        if (change < 1e-12)
+            break;
+    }
+
+    // Mirroring goes to the stretch so that R is a proper rotation.
+    const auto det = R(0, 0) * (R(1, 1) * R(2, 2) - R(1, 2) * R(2, 1)) -
+                     R(0, 1) * (R(1, 0) * R(2, 2) - R(1, 2) * R(2, 0)) +
+                     R(0, 2) * (R(1, 0) * R(2, 1) - R(1, 1) * R(2, 0));
+    if (det < 0.0) {
+        R = R * Matrix::scale(-1, -1, -1);
+    }
+
+    S = transpose(R) * A;
+}
+
+Vector toQuaternion(const Matrix& R) {
+    const auto trace = R(0, 0) + R(1, 1) + R(2, 2);
+    if (trace > 0.0) {
+        const auto s = 0.5 / sqrt(trace + 1.0);
+        return {(R(2, 1) - R(1, 2)) * s, (R(0, 2) - R(2, 0)) * s,
+                (R(1, 0) - R(0, 1)) * s, 0.25 / s};
+    }
+
+    if (R(0, 0) > R(1, 1) && R(0, 0) > R(2, 2)) {
+        const auto s = 2.0 * sqrt(1.0 + R(0, 0) - R(1, 1) - R(2, 2));
+        return {0.25 * s, (R(0, 1) + R(1, 0)) / s, (R(0, 2) + R(2, 0)) / s,
+                (R(2, 1) - R(1, 2)) / s};
+    }
+
+    if (R(1, 1) > R(2, 2)) {
+        const auto s = 2.0 * sqrt(1.0 + R(1, 1) - R(0, 0) - R(2, 2));
+        return {(R(0, 1) + R(1, 0)) / s, 0.25 * s, (R(1, 2) + R(2, 1)) / s,
+                (R(0, 2) - R(2, 0)) / s};
+    }
+
+    const auto s = 2.0 * sqrt(1.0 + R(2, 2) - R(0, 0) - R(1, 1));
+    return {(R(0, 2) + R(2, 0)) / s, (R(1, 2) + R(2, 1)) / s, 0.25 * s,
+            (R(1, 0) - R(0, 1)) / s};
+}
+
+Matrix fromQuaternion(const Vector& q) {
+    const auto xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    const auto xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    const auto xw = q.x * q.w, yw = q.y * q.w, zw = q.z * q.w;
+    return {1 - 2 * (yy + zz), 2 * (xy - zw),     2 * (xz + yw),     0,
+            2 * (xy + zw),     1 - 2 * (xx + zz), 2 * (yz - xw),     0,
+            2 * (xz - yw),     2 * (yz + xw),     1 - 2 * (xx + yy), 0,
+            0,                 0,                 0,                 1};
+}
+
+/// Interpolates translation, rotation and stretch of affine transformations.
+Matrix interpolate(const Matrix& a, const Matrix& b, floating s) {
+    Matrix Ra, Sa, Rb, Sb;
+    polarDecompose(a, Ra, Sa);
+    polarDecompose(b, Rb, Sb);
+
+    const auto qa = toQuaternion(Ra);
+    auto       qb = toQuaternion(Rb);
+    if (qa.dot(qb) < 0.0)
+        qb = -1.0 * qb;
+
+    const auto T = Matrix::translate(lerp(a(0, 3), b(0, 3), s),
+                                     lerp(a(1, 3), b(1, 3), s),
+                                     lerp(a(2, 3), b(2, 3), s));
+    return T * fromQuaternion(slerp(qa, qb, s)) * lerp(Sa, Sb, s);
+}
+
+} // namespace anonymous
+
+void Animation::addCameraKey(const CameraKey& key) {
+    const auto pos = std::upper_bound(
+        m_cameraKeys.begin(), m_cameraKeys.end(), key.time,
+        [](floating t, const CameraKey& other) { return t < other.time; });
+    m_cameraKeys.insert(pos, key);
+}
+
+void Animation::addInstanceKey(Instance* instance, const InstanceKey& key) {
+    if (m_tracks.empty() || m_tracks.back().instance != instance)
+        m_tracks.push_back(Track{instance, {}});
+
+    auto&      keys = m_tracks.back().keys;
+    const auto pos = std::upper_bound(
+        keys.begin(), keys.end(), key.time,
+        [](floating t, const InstanceKey& other) { return t < other.time; });
+    keys.insert(pos, key);
+}
+
+void Animation::apply(floating time, Camera& camera,
+                      PrimitiveManager& manager) const {
+    size_t   i;
+    floating s;
+    if (!m_cameraKeys.empty()) {
+        keyInterval(m_cameraKeys, time, i, s);
+        const auto& a = m_cameraKeys[i];
+        const auto& b = m_cameraKeys[std::min(i + 1, m_cameraKeys.size() - 1)];
+
+        // The eye moves around the target instead of cutting across.
+        const auto at = lerp(a.at, b.at, s);
+        const auto offsetA = a.from - a.at;
+        const auto offsetB = b.from - b.at;
+        const auto dist = lerp(offsetA.length(), offsetB.length(), s);
+        const auto dir = slerp(normalised(offsetA), normalised(offsetB), s);
+
+        auto params = camera.parameters();
+        params.from = Point{at.x + dist * dir.x, at.y + dist * dir.y,
+                            at.z + dist * dir.z};
+        params.at = Point{at.x, at.y, at.z};
+        params.up = lerp(a.up, b.up, s);
+        params.fov = lerp(a.fov, b.fov, s);
+        camera.setup(params);
+    }
+
+    std::vector<const Primitive*> moved;
+    moved.reserve(m_tracks.size());
+    for (const auto& track : m_tracks) {
+        keyInterval(track.keys, time, i, s);
+        const auto& a = track.keys[i];
+        const auto& b = track.keys[std::min(i + 1, track.keys.size() - 1)];
+        const auto toWorld = s > 0.0 && a.toWorld != b.toWorld
+                                 ? interpolate(a.toWorld, b.toWorld, s)
+                                 : a.toWorld;
+        if (toWorld == track.instance->toWorld())
+            continue; // held between equal keys or past the last one
+
+        track.instance->setTransform(toWorld);
+        moved.push_back(track.instance);
+    }
+
+    if (!moved.empty())
+        manager.update(moved);
+}
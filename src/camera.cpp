@@ -1,27 +1,43 @@
 #include "camera.h"
 
+#include "random.h"
+
 #include <cmath>
 
-void Camera::setup(Point from, Point at, Vector up, floating fov,
-                   floating hither, size_t width, size_t height) {
-    const auto near = hither;
+void Camera::setup(const Parameters& params) {
+    const auto near = params.hither;
     const auto far = 10000.0;
+    const auto width = params.width;
+    const auto height = params.height;
     const auto asp = (floating)width / height;
 
-    const auto MV = Matrix::lookAt(from, at, up);
-    const auto P = Matrix::perspective(fov, asp, near, far);
+    const auto MV = Matrix::lookAt(params.from, params.at, params.up);
+    const auto P = Matrix::perspective(params.fov, asp, near, far);
     const auto MVP = P * MV;
     const auto invMVP = invert(MVP);
 
-    m_eye = from;
+    m_parameters = params;
+    m_eye = params.from;
     m_width = width;
     m_height = height;
-    m_forward = normalised(at - from);
+    m_forward = normalised(params.at - params.from);
     m_toScreen = Matrix::scale(width / 2.0, height / 2.0, 0) *
                  Matrix::translate(1.0, 1.0, 0.0) * MVP;
     m_fromScreen = invMVP * Matrix::translate(-1.0, -1.0, 0.0) *
                    Matrix::scale(2.0 / width, 2.0 / height, 0.0);
-    m_imagePlaneDistance = width / (2.0 * tan(fov * M_PI / 360.0));
+    m_imagePlaneDistance = width / (2.0 * tan(params.fov * M_PI / 360.0));
+
+    // Screen plane is flat in the world, so the directions are affine in the
+    // screen coordinates.
+    const auto origin = m_fromScreen.transform(Point{0.0, 0.0, 0.0});
+    m_corner = origin - m_eye;
+    m_dx = m_fromScreen.transform(Point{1.0, 0.0, 0.0}) - origin;
+    m_dy = m_fromScreen.transform(Point{0.0, 1.0, 0.0}) - origin;
+    m_right = normalised(m_dx);
+    m_down = normalised(m_dy);
+    m_lensRadius = params.aperture;
+    m_focusDistance = params.focus > 0.0 ? params.focus
+                                         : (params.at - params.from).length();
 }
 
 bool Camera::raster(Point worldPoint, floating& x, floating& y) const {
@@ -34,9 +50,38 @@ bool Camera::raster(Point worldPoint, floating& x, floating& y) const {
            screenPoint.y < m_height;
 }
 
-Ray Camera::spawnRay(floating x, floating y) const {
-    const auto screenPoint = Point{x, y, 0.0};
-    const auto worldPoint = m_fromScreen.transform(screenPoint);
-    const auto direction = normalised(worldPoint - m_eye);
-    return {m_eye, direction};
+bool Camera::raster(Point worldPoint, Point lensPoint, floating& x,
+                    floating& y) const {
+    if (m_lensRadius == 0.0)
+        return raster(worldPoint, x, y);
+
+    // Rays from the lens to a point of the focus plane all come from the
+    // same screen point as the ray through the centre of the lens.
+    const auto direction = worldPoint - lensPoint;
+    const auto cosAtCamera = direction.dot(m_forward);
+    if (cosAtCamera <= 0.0)
+        return false;
+
+    const auto focusPoint =
+        lensPoint + (m_focusDistance / cosAtCamera) * direction;
+    return raster(focusPoint, x, y);
+}
+
+Point Camera::sampleLens(Sampler& sampler) const {
+    if (m_lensRadius == 0.0)
+        return m_eye;
+
+    const auto disc = sampleConcentricDisc(sampler).get();
+    return m_eye + m_lensRadius * (disc.x * m_right + disc.y * m_down);
+}
+
+Ray Camera::spawnRay(floating x, floating y, Sampler& sampler) const {
+    const auto direction = m_corner + x * m_dx + y * m_dy;
+    if (m_lensRadius == 0.0)
+        return {m_eye, normalised(direction)};
+
+    const auto lensPoint = sampleLens(sampler);
+    const auto focusPoint =
+        m_eye + (m_focusDistance / direction.dot(m_forward)) * direction;
+    return {lensPoint, normalised(focusPoint - lensPoint)};
 }
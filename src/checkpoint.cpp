@@ -0,0 +1,231 @@
+#include "checkpoint.h"
+
+#include "binary_io.h"
+#include "framebuffer.h"
+#include "mapped_file.h"
+#include "surface.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+
+namespace /* anonymous */ {
+
+const uint64_t checkpointMagic = 0x544e494f50594152; // "RAYPOINT"
+const uint32_t checkpointVersion = 2;
+
+struct Header {
+    std::string job;
+    uint64_t    shard;
+    uint64_t    shards;
+    uint32_t    width;
+    uint32_t    height;
+};
+
+void writeHeader(BinaryWriter& out, const Header& header) {
+    out.write(checkpointMagic);
+    out.write(checkpointVersion);
+    out.write<uint64_t>(header.job.size());
+    for (const auto c : header.job)
+        out.write(c);
+
+    out.write(header.shard);
+    out.write(header.shards);
+    out.write(header.width);
+    out.write(header.height);
+}
+
+bool readHeader(BinaryReader& in, Header& header) {
+    if (in.read<uint64_t>() != checkpointMagic ||
+        in.read<uint32_t>() != checkpointVersion)
+        return false;
+
+    const auto jobSize = in.read<uint64_t>();
+    header.job.clear();
+    for (uint64_t i = 0; i < jobSize && in.ok(); ++i)
+        header.job.push_back(in.read<char>());
+
+    header.shard = in.read<uint64_t>();
+    header.shards = in.read<uint64_t>();
+    header.width = in.read<uint32_t>();
+    header.height = in.read<uint32_t>();
+    return in.ok();
+}
+
+} // anonymous namespace
+
+bool Checkpoint::save(const Framebuffer (&halves)[2],
+                      const size_t (&counts)[2]) const {
+    const auto   width = halves[0].width();
+    const auto   height = halves[0].height();
+    BinaryWriter out;
+    writeHeader(out, Header{m_job, m_shard, m_shards, uint32_t(width),
+                            uint32_t(height)});
+    for (size_t i = 0; i < 2; ++i) {
+        out.write<uint64_t>(counts[i]);
+        for (size_t x = 0; x < width; ++x) {
+            for (size_t y = 0; y < height; ++y) {
+                const auto& stats = halves[i].unsafeGetStatistics(x, y);
+                out.writeVector(halves[i].unsafeGetPixel(x, y));
+                out.write<uint64_t>(stats.count);
+                out.writeVector(stats.mean);
+                out.write(stats.m2);
+            }
+        }
+    }
+
+    // Written under a temporary name so that the previous checkpoint stays
+    // if the process dies while writing.
+    const auto  tmpFile = m_fname + ".tmp";
+    const auto& buffer = out.buffer();
+    FILE*       fptr = fopen(tmpFile.c_str(), "wb");
+    if (fptr == nullptr)
+        return false;
+
+    const bool ok =
+        fwrite(buffer.data(), 1, buffer.size(), fptr) == buffer.size();
+    if (fclose(fptr) != 0 || !ok ||
+        rename(tmpFile.c_str(), m_fname.c_str()) != 0) {
+        remove(tmpFile.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool Checkpoint::load(Framebuffer (&halves)[2], size_t (&counts)[2]) const {
+    return read(halves, counts, false);
+}
+
+bool Checkpoint::add(Framebuffer (&halves)[2], size_t (&counts)[2]) const {
+    return read(halves, counts, true);
+}
+
+bool Checkpoint::read(Framebuffer (&halves)[2], size_t (&counts)[2],
+                      bool add) const {
+    const MappedFile file{m_fname};
+    if (!file.isOpen())
+        return false;
+
+    BinaryReader in{file.begin(), file.end()};
+    Header       header;
+    const auto   width = halves[0].width();
+    const auto   height = halves[0].height();
+    if (!readHeader(in, header) || header.job != m_job ||
+        header.shard != m_shard || header.shards != m_shards ||
+        header.width != width || header.height != height)
+        return false;
+
+    const auto pixelSize = 8 * sizeof(floating);
+    if (in.remaining() != 2 * (8 + width * height * pixelSize))
+        return false;
+
+    for (size_t i = 0; i < 2; ++i) {
+        const auto count = in.read<uint64_t>();
+        counts[i] = add ? counts[i] + count : count;
+        for (size_t x = 0; x < width; ++x) {
+            for (size_t y = 0; y < height; ++y) {
+                auto            splats = in.readColour();
+                PixelStatistics stats;
+                stats.count = in.read<uint64_t>();
+                stats.mean = in.readColour();
+                stats.m2 = in.read<floating>();
+                if (add) {
+                    splats += halves[i].unsafeGetPixel(x, y);
+                    stats = halves[i].unsafeGetStatistics(x, y) + stats;
+                }
+
+                halves[i].unsafeRestore(x, y, splats, stats);
+            }
+        }
+    }
+
+    return in.ok();
+}
+
+bool mergeShards(const std::vector<std::string>& files,
+                 const std::vector<std::unique_ptr<Surface>>& surfaces) {
+    std::vector<Header> headers(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        const MappedFile file{files[i]};
+        BinaryReader     in{file.begin(), file.end()};
+        if (!file.isOpen() || !readHeader(in, headers[i])) {
+            std::cerr << "Unable to read checkpoint " << files[i] << std::endl;
+            return false;
+        }
+    }
+
+    if (headers.empty()) {
+        std::cerr << "No shards to merge." << std::endl;
+        return false;
+    }
+
+    // Every shard must be there exactly once, otherwise some passes would
+    // be missing or counted twice.
+    const auto& first = headers.front();
+    for (size_t i = 0; i < files.size(); ++i) {
+        const auto& header = headers[i];
+        if (header.job != first.job || header.shards != first.shards ||
+            header.width != first.width || header.height != first.height) {
+            std::cerr << "Checkpoint " << files[i]
+                      << " is of another render than " << files[0]
+                      << std::endl;
+            return false;
+        }
+    }
+
+    if (files.size() != first.shards) {
+        std::cerr << "Merging " << files.size() << " of " << first.shards
+                  << " shards." << std::endl;
+        return false;
+    }
+
+    std::vector<bool> seen(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        const auto shard = headers[i].shard;
+        if (shard >= seen.size()) {
+            std::cerr << "Shard " << shard << " of " << files[i]
+                      << " is out of range of " << first.shards
+                      << " shards." << std::endl;
+            return false;
+        }
+
+        if (seen[shard]) {
+            std::cerr << "Shard " << shard << " of " << files[i]
+                      << " is given twice." << std::endl;
+            return false;
+        }
+
+        seen[shard] = true;
+    }
+
+    Framebuffer halves[2] = {{first.width, first.height},
+                             {first.width, first.height}};
+    size_t      counts[2] = {0, 0};
+    for (size_t i = 0; i < files.size(); ++i) {
+        const Checkpoint checkpoint{files[i], first.job, headers[i].shard,
+                                    first.shards};
+        if (!checkpoint.add(halves, counts)) {
+            std::cerr << "Checkpoint " << files[i] << " is damaged."
+                      << std::endl;
+            return false;
+        }
+    }
+
+    if (counts[0] + counts[1] == 0) {
+        std::cerr << "Shards have no samples." << std::endl;
+        return false;
+    }
+
+    for (auto& surface : surfaces) {
+        surface->setDimensions(first.height, first.width);
+        surface->init();
+        for (size_t x = 0; x < first.width; ++x)
+            for (size_t y = 0; y < first.height; ++y)
+                surface->setPixel(y, x, pixelColour(halves, x, y, counts));
+    }
+
+    std::cout << "Merged " << counts[0] + counts[1] << " samples of "
+              << first.shards << " shards." << std::endl;
+    return true;
+}
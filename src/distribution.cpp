@@ -0,0 +1,108 @@
+#include "distribution.h"
+
+#include <algorithm>
+#include <cstddef>
+
+void AliasTable::build(const std::vector<floating>& weights) {
+    const auto n = weights.size();
+    m_bins.assign(n, Bin{0, 1, 0});
+    if (n == 0)
+        return;
+
+    floating total = 0.0;
+    for (auto w : weights)
+        total += std::max(w, 0.0);
+
+    std::vector<floating> scaled(n);
+    for (size_t i = 0; i < n; ++i) {
+        const auto pr = total > 0.0 ? std::max(weights[i], 0.0) / total
+                                    : 1.0 / n;
+        m_bins[i].pr = (float)pr;
+        m_bins[i].alias = (uint32_t)i;
+        scaled[i] = pr * n;
+    }
+
+    std::vector<uint32_t> small, large;
+    for (size_t i = 0; i < n; ++i) {
+        if (scaled[i] < 1.0)
+            small.push_back((uint32_t)i);
+        else
+            large.push_back((uint32_t)i);
+    }
+
+    while (!small.empty() && !large.empty()) {
+        const auto s = small.back();
+        const auto l = large.back();
+        small.pop_back();
+        large.pop_back();
+
+        m_bins[s].threshold = (float)scaled[s];
+        m_bins[s].alias = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+        if (scaled[l] < 1.0)
+            small.push_back(l);
+        else
+            large.push_back(l);
+    }
+
+    // Remaining bins are full up to rounding errors.
+    for (auto i : small)
+        m_bins[i].threshold = 1;
+    for (auto i : large)
+        m_bins[i].threshold = 1;
+}
+
+void Distribution1D::build(const floating* func, size_t n) {
+    m_func.assign(func, func + n);
+    m_cdf.assign(n + 1, 0);
+    for (auto& f : m_func)
+        f = std::max(f, 0.0f);
+
+    double acc = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        acc += (double)m_func[i] / n;
+        m_cdf[i + 1] = (float)acc;
+    }
+
+    m_integral = acc;
+    if (acc <= 0.0) {
+        std::fill(m_func.begin(), m_func.end(), 1.0f);
+        for (size_t i = 1; i <= n; ++i)
+            m_cdf[i] = (float)i / n;
+        m_integral = 1.0;
+        return;
+    }
+
+    for (size_t i = 1; i <= n; ++i)
+        m_cdf[i] = (float)(m_cdf[i] / acc);
+    m_cdf[n] = 1.0f;
+}
+
+floating Distribution1D::sample(floating u, floating& pdf,
+                                size_t& offset) const {
+    const auto n = m_func.size();
+    const auto it = std::upper_bound(m_cdf.begin(), m_cdf.end(), (float)u);
+    const auto i = std::max(it - m_cdf.begin() - 1, std::ptrdiff_t{0});
+    offset = std::min((size_t)i, n - 1);
+
+    auto       du = u - m_cdf[offset];
+    const auto width = m_cdf[offset + 1] - m_cdf[offset];
+    if (width > 0.0f)
+        du /= width;
+
+    pdf = m_func[offset] / m_integral;
+    return std::min((offset + du) / n, 1.0 - epsilon);
+}
+
+void Distribution2D::build(const floating* func, size_t nu, size_t nv) {
+    m_conditional.resize(nv);
+    std::vector<floating> marginal(nv, 0.0);
+    for (size_t v = 0; v < nv; ++v) {
+        const auto row = func + v * nu;
+        m_conditional[v].build(row, nu);
+        for (size_t u = 0; u < nu; ++u)
+            marginal[v] += std::max(row[u], 0.0) / nu;
+    }
+
+    m_marginal.build(marginal.data(), nv);
+}
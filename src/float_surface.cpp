@@ -0,0 +1,187 @@
+#include "float_surface.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace /* anonymous */ {
+
+/// Both formats are little endian.
+void storeUint32(char* p, uint32_t x) {
+    for (size_t i = 0; i < 4; ++i)
+        p[i] = char((x >> (8 * i)) & 0xff);
+}
+
+void storeUint64(char* p, uint64_t x) {
+    storeUint32(p, uint32_t(x));
+    storeUint32(p + 4, uint32_t(x >> 32));
+}
+
+void storeFloat(char* p, float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    storeUint32(p, bits);
+}
+
+void appendUint32(std::string& out, uint32_t x) {
+    char bytes[4];
+    storeUint32(bytes, x);
+    out.append(bytes, 4);
+}
+
+void appendFloat(std::string& out, float f) {
+    char bytes[4];
+    storeFloat(bytes, f);
+    out.append(bytes, 4);
+}
+
+/// Attribute of an OpenEXR header.
+void appendAttribute(std::string& out, const char* name, const char* type,
+                     const std::string& value) {
+    out.append(name, strlen(name) + 1);
+    out.append(type, strlen(type) + 1);
+    appendUint32(out, value.size());
+    out += value;
+}
+
+} // namespace anonymous
+
+FloatSurface::~FloatSurface() {
+    write();
+    unmap();
+}
+
+void FloatSurface::init() {
+    unmap();
+    m_layout = layout();
+    const auto fd = open(m_fname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Unable to open/create file " << m_fname << std::endl;
+        return;
+    }
+
+    void* addr = MAP_FAILED;
+    if (ftruncate(fd, m_layout.size) == 0) {
+        addr = mmap(nullptr, m_layout.size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Unable to map file " << m_fname << std::endl;
+        return;
+    }
+
+    m_data = static_cast<char*>(addr);
+    m_size = m_layout.size;
+    writeHeader(m_data);
+}
+
+void FloatSurface::setPixel(int h, int w, const Colour& c) {
+    if (m_data == nullptr)
+        return;
+
+    auto p = m_data + m_layout.first + h * m_layout.row + w * m_layout.pixel;
+    storeFloat(p, c.r);
+    storeFloat(p + m_layout.channel, c.g);
+    storeFloat(p + 2 * m_layout.channel, c.b);
+}
+
+void FloatSurface::write() {
+    if (m_data != nullptr)
+        msync(m_data, m_size, MS_ASYNC);
+}
+
+void FloatSurface::unmap() {
+    if (m_data != nullptr)
+        munmap(m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
+
+std::string PfmSurface::header() const {
+    char header[64];
+    // Negative scale marks little endian data.
+    snprintf(header, sizeof(header), "PF\n%d %d\n-1.0\n", m_width, m_height);
+    return header;
+}
+
+FloatSurface::Layout PfmSurface::layout() const {
+    const auto rowSize = ptrdiff_t(12) * m_width;
+    const auto headerSize = header().size();
+    return {headerSize + size_t(rowSize) * m_height,
+            headerSize + size_t(rowSize) * (m_height - 1), -rowSize, 12, 4};
+}
+
+void PfmSurface::writeHeader(char* data) const {
+    const auto text = header();
+    memcpy(data, text.data(), text.size());
+}
+
+std::string ExrSurface::header() const {
+    std::string channels;
+    for (const char* name : {"B", "G", "R"}) {
+        channels.append(name, 2);
+        appendUint32(channels, 2); // float
+        channels.append(4, '\0');  // linear and reserved
+        appendUint32(channels, 1); // sampling
+        appendUint32(channels, 1);
+    }
+
+    channels.push_back('\0');
+
+    std::string window;
+    appendUint32(window, 0);
+    appendUint32(window, 0);
+    appendUint32(window, m_width - 1);
+    appendUint32(window, m_height - 1);
+
+    std::string center, one;
+    appendFloat(center, 0.0f);
+    appendFloat(center, 0.0f);
+    appendFloat(one, 1.0f);
+
+    std::string out;
+    appendUint32(out, 20000630); // magic
+    appendUint32(out, 2);        // version, single part scanline image
+    appendAttribute(out, "channels", "chlist", channels);
+    appendAttribute(out, "compression", "compression", std::string(1, '\0'));
+    appendAttribute(out, "dataWindow", "box2i", window);
+    appendAttribute(out, "displayWindow", "box2i", window);
+    appendAttribute(out, "lineOrder", "lineOrder", std::string(1, '\0'));
+    appendAttribute(out, "pixelAspectRatio", "float", one);
+    appendAttribute(out, "screenWindowCenter", "v2f", center);
+    appendAttribute(out, "screenWindowWidth", "float", one);
+    out.push_back('\0');
+    return out;
+}
+
+// Header is followed by the offsets of the scanlines, every scanline starts
+// with its y coordinate and the size of its pixels.
+FloatSurface::Layout ExrSurface::layout() const {
+    const auto channelSize = ptrdiff_t(4) * m_width;
+    const auto lineSize = 8 + 3 * channelSize;
+    const auto start = header().size() + 8 * size_t(m_height);
+    return {start + size_t(lineSize) * m_height, start + 8 + 2 * channelSize,
+            lineSize, 4, -channelSize};
+}
+
+void ExrSurface::writeHeader(char* data) const {
+    const auto text = header();
+    memcpy(data, text.data(), text.size());
+
+    const auto lineSize = 8 + 12 * size_t(m_width);
+    const auto start = text.size() + 8 * size_t(m_height);
+    for (int y = 0; y < m_height; ++y) {
+        const auto offset = start + lineSize * y;
+        storeUint64(data + text.size() + 8 * y, offset);
+        storeUint32(data + offset, y);
+        storeUint32(data + offset + 4, lineSize - 8);
+    }
+}
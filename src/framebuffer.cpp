@@ -1,6 +1,8 @@
 #include "framebuffer.h"
 #include "camera.h"
 #include "aabb.h"
+#include "sample_schedule.h"
+#include "statistics.h"
 
 #include <boost/thread/tss.hpp>
 
@@ -12,11 +14,13 @@ struct FramebufferUpdate {
     const size_t x;
     const size_t y;
     const Colour col;
+    const bool   sample; ///< Sample of the pixel rather than a splat.
 
-    FramebufferUpdate(size_t x, size_t y, Colour col)
+    FramebufferUpdate(size_t x, size_t y, Colour col, bool sample)
         : x{x}
         , y{y}
         , col{col}
+        , sample{sample}
     {}
 };
 
@@ -33,7 +37,9 @@ FramebufferUpdateQueue& updateQueue() {
 } // namespace anonymous
 
 Framebuffer::Framebuffer(size_t width, size_t height)
-    : table<Colour>{width, height, Colour{0, 0, 0}} {}
+    : table<Colour>{width, height, Colour{0, 0, 0}}
+    , m_statistics{width, height}
+    , m_schedule{nullptr} {}
 
 Colour Framebuffer::getPixel(size_t x, size_t y) const {
     boost::mutex::scoped_lock scoped_lock{m_mutex};
@@ -43,12 +49,19 @@ Colour Framebuffer::getPixel(size_t x, size_t y) const {
 void Framebuffer::clear() {
     boost::mutex::scoped_lock scoped_lock{m_mutex};
     std::fill(begin(), end(), Colour{0, 0, 0});
+    m_statistics.fill(PixelStatistics{});
 }
 
 void Framebuffer::flushUpdates() {
     boost::mutex::scoped_lock scoped_lock{m_mutex};
+    auto&                     statistics = threadStatistics();
+    ++statistics.flushes;
+    statistics.flushedUpdates += updateQueue().size();
     for (const auto& update : updateQueue()) {
-        unsafeAddColour(update.x, update.y, update.col);
+        if (update.sample)
+            m_statistics(update.x, update.y).add(update.col);
+        else
+            unsafeAddColour(update.x, update.y, update.col);
     }
 
     updateQueue().clear();
@@ -58,7 +71,29 @@ void Framebuffer::addColour(size_t x, size_t y, Colour col) {
     if (updateQueue().size() >= updateBufferSize)
         flushUpdates();
 
-    updateQueue().emplace_back(x, y, col);
+    updateQueue().emplace_back(x, y, col, false);
+}
+
+void Framebuffer::addSample(size_t x, size_t y, Colour col) {
+    if (updateQueue().size() >= updateBufferSize)
+        flushUpdates();
+
+    updateQueue().emplace_back(x, y, col, true);
+}
+
+void Framebuffer::add(const Framebuffer& other) {
+    boost::mutex::scoped_lock scoped_lock{m_mutex};
+    for (size_t x = 0; x < width(); ++x) {
+        for (size_t y = 0; y < height(); ++y) {
+            unsafeAddColour(x, y, other.unsafeGetPixel(x, y));
+            m_statistics(x, y) =
+                m_statistics(x, y) + other.unsafeGetStatistics(x, y);
+        }
+    }
+}
+
+size_t Framebuffer::samples(size_t x, size_t y) const {
+    return m_schedule != nullptr ? m_schedule->samples(x, y) : 1;
 }
 
 void Framebuffer::unsafeDrawAabb(const Camera& cam, const Aabb& box,
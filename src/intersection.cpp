@@ -0,0 +1,28 @@
+#include "intersection.h"
+
+#include "instance.h"
+#include "primitive.h"
+
+Vector Intersection::normal() const {
+    if (m_instance != nullptr)
+        return m_instance->normal(*m_primitive, m_point);
+    return m_primitive->normal(m_point);
+}
+
+material_index_t Intersection::material() const {
+    if (m_instance != nullptr && m_instance->overridesMaterial())
+        return m_instance->material();
+    return m_primitive->material();
+}
+
+texture_index_t Intersection::texture() const {
+    if (m_instance != nullptr && m_instance->overridesMaterial())
+        return -1;
+    return m_primitive->texture();
+}
+
+Colour Intersection::texel(const Texture* texture) const {
+    const auto pos =
+        m_instance != nullptr ? m_instance->toObject(m_point) : m_point;
+    return m_primitive->getColourAtIntersection(pos, texture);
+}
@@ -1,14 +1,19 @@
 #include "kdtree_primitive_manager.h"
 
+#include "binary_io.h"
 #include "camera.h"
 #include "framebuffer.h"
 #include "intersection.h"
 #include "primitive.h"
 #include "ray.h"
 #include "scene_sphere.h"
+#include "statistics.h"
 
 #include <algorithm>
 #include <cassert>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
 
 using PrimPtr = const Primitive*;
 
@@ -95,12 +100,16 @@ struct StackElem {
 KdTreePrimitiveManager::KdTreePrimitiveManager()
     : m_root{nullptr} {}
 
-KdTreePrimitiveManager::~KdTreePrimitiveManager() {
+KdTreePrimitiveManager::~KdTreePrimitiveManager() { clear(); }
+
+void KdTreePrimitiveManager::clear() {
     for (auto prim : m_prims) {
         delete prim;
     }
 
+    m_prims.clear();
     Node::release(m_root);
+    m_root = nullptr;
 }
 
 void drawTree(const Camera& cam, Framebuffer& buf, const Aabb& box,
@@ -284,6 +293,165 @@ void KdTreePrimitiveManager::init() {
               << std::endl;
 }
 
+/// Leaves that grow to this many primitives by updates are split again.
+const size_t updateLeafSize = 8;
+
+/// Removes the primitives in @a moved from the leaves below @a node.
+Node* removeFromKDTree(Node* node, const std::unordered_set<PrimPtr>& moved) {
+    if (node == nullptr)
+        return nullptr;
+
+    if (node->m_axis < 3) {
+        node->m_left = removeFromKDTree(node->m_left, moved);
+        node->m_right = removeFromKDTree(node->m_right, moved);
+        return node;
+    }
+
+    PrimList kept;
+    for (const PrimPtr* ptr = node->m_prims; *ptr; ++ptr) {
+        if (moved.count(*ptr) == 0)
+            kept.push_back(*ptr);
+    }
+
+    if (kept.size() + 1 == node->size())
+        return node;
+
+    Node::release(node);
+    return Node::make(kept);
+}
+
+/**
+ * Adds @a added to the leaves below @a node whose cells they overlap. A leaf
+ * that becomes too large is replaced by a subtree built over its cell, once
+ * for all the primitives that it receives.
+ */
+Node* insertIntoKDTree(Node* node, const PrimList& added, const Aabb& box,
+                       int depth) {
+    if (added.empty())
+        return node;
+
+    if (node != nullptr && node->m_axis < 3) {
+        const auto axis = node->m_axis;
+        const auto split = node->m_split;
+        Aabb       leftBox, rightBox;
+        box.split_at(leftBox, rightBox, axis, split);
+        PrimList lefts, rights;
+        for (auto prim : added) {
+            if (prim->getLeftExtreme(axis) < split)
+                lefts.push_back(prim);
+            if (prim->getRightExtreme(axis) >= split)
+                rights.push_back(prim);
+        }
+
+        node->m_left =
+            insertIntoKDTree(node->m_left, lefts, leftBox, depth + 1);
+        node->m_right =
+            insertIntoKDTree(node->m_right, rights, rightBox, depth + 1);
+        return node;
+    }
+
+    PrimList prims;
+    if (node != nullptr)
+        prims.assign(node->m_prims, node->m_prims + node->size() - 1);
+    prims.insert(prims.end(), added.begin(), added.end());
+    Node::release(node);
+    if (prims.size() >= updateLeafSize)
+        return buildKDTree(prims, box, depth);
+
+    return Node::make(prims);
+}
+
+// The tree keeps its split planes, moved primitives are removed from their
+// old leaves and inserted to the new ones. The scene box only grows, the
+// outermost cells grow with it.
+void KdTreePrimitiveManager::update(const PrimList& moved) {
+    if (m_root == nullptr || moved.empty())
+        return;
+
+    const std::unordered_set<PrimPtr> movedSet{moved.begin(), moved.end()};
+    m_root = removeFromKDTree(m_root, movedSet);
+
+    for (auto prim : moved) {
+        for (uint8_t i = 0; i < 3; ++i) {
+            m_bbox.m_p1[i] = fmin(m_bbox.m_p1[i], prim->getLeftExtreme(i));
+            m_bbox.m_p2[i] = fmax(m_bbox.m_p2[i], prim->getRightExtreme(i));
+        }
+    }
+
+    m_root = insertIntoKDTree(m_root, moved, m_bbox, 0);
+}
+
+/**
+ * Nodes are written in preorder. Every subtree starts with a marker that tells
+ * if it is present, nodes store the split and the indices of their primitives.
+ */
+void writeKDTree(BinaryWriter& out, const Node* node,
+                 const std::unordered_map<PrimPtr, uint32_t>& indices) {
+    out.write<uint8_t>(node != nullptr);
+    if (node == nullptr)
+        return;
+
+    out.write(node->m_split);
+    out.write(node->m_axis);
+    out.write<uint32_t>(node->size() - 1);
+    for (const PrimPtr* ptr = node->m_prims; *ptr; ++ptr)
+        out.write(indices.at(*ptr));
+
+    writeKDTree(out, node->m_left, indices);
+    writeKDTree(out, node->m_right, indices);
+}
+
+bool readKDTree(BinaryReader& in, const PrimList& prims, Node*& node) {
+    node = nullptr;
+    if (in.read<uint8_t>() == 0)
+        return in.ok();
+
+    const auto split = in.read<floating>();
+    const auto axis = in.read<uint8_t>();
+    const auto count = in.read<uint32_t>();
+    if (!in.ok() || axis > 3 || count > in.remaining() / sizeof(uint32_t))
+        return false;
+
+    PrimList nodePrims;
+    nodePrims.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const auto index = in.read<uint32_t>();
+        if (index >= prims.size())
+            return false;
+
+        nodePrims.push_back(prims[index]);
+    }
+
+    node = Node::make(nodePrims);
+    node->m_split = split;
+    node->m_axis = axis;
+    return readKDTree(in, prims, node->m_left) &&
+           readKDTree(in, prims, node->m_right);
+}
+
+void KdTreePrimitiveManager::write(BinaryWriter& out) const {
+    std::unordered_map<PrimPtr, uint32_t> indices;
+    indices.reserve(m_prims.size());
+    for (size_t i = 0; i < m_prims.size(); ++i)
+        indices.emplace(m_prims[i], (uint32_t)i);
+
+    out.writeVector(m_bbox.m_p1);
+    out.writeVector(m_bbox.m_p2);
+    writeKDTree(out, m_root, indices);
+}
+
+bool KdTreePrimitiveManager::read(BinaryReader& in) {
+    m_bbox.m_p1 = in.readPoint();
+    m_bbox.m_p2 = in.readPoint();
+    if (!readKDTree(in, m_prims, m_root) || !in.ok()) {
+        Node::release(m_root);
+        m_root = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
 void KdTreePrimitiveManager::addPrimitive(const Primitive* p) {
     assert(p != nullptr);
     m_prims.push_back(p);
@@ -306,11 +474,19 @@ Intersection KdTreePrimitiveManager::intersectWithPrims(const Ray& ray) const {
     Node*     cur = m_root;
     floating  a, b, t;
     int       en = 0, ex = 1, tmp;
+    size_t    nodes = 0, tests = 0;
 
     if (!intersectAabb(m_bbox, ray, a, b)) {
         return {};
     }
 
+    // Counted locally, the statistics are thread local.
+    const auto record = [&]() {
+        auto& statistics = threadStatistics();
+        statistics.nodesVisited += nodes;
+        statistics.primitivesTested += tests;
+    };
+
     stack[en].t = a;
     stack[en].pb = ray.origin();
 
@@ -324,6 +500,7 @@ Intersection KdTreePrimitiveManager::intersectWithPrims(const Ray& ray) const {
 
     while (cur != nullptr) {
         while (cur->m_axis < 3) {
+            ++nodes;
             const float split = cur->m_split;
             uint8_t     axis = cur->m_axis;
 
@@ -363,10 +540,12 @@ Intersection KdTreePrimitiveManager::intersectWithPrims(const Ray& ray) const {
             stack[ex].pb[axis] = ray.origin(axis) + t * ray.dir(axis);
         }
 
+        ++nodes;
         {
             Intersection intr;
             for (PrimPtr *ptr = cur->prims(); *ptr; ++ptr) {
                 auto prim = *ptr;
+                ++tests;
                 prim->intersect(ray, intr);
                 if (intr.hasIntersections()) {
                     if (intr.dist() < stack[en].t - epsilon ||
@@ -377,6 +556,7 @@ Intersection KdTreePrimitiveManager::intersectWithPrims(const Ray& ray) const {
             }
 
             if (intr.hasIntersections()) {
+                record();
                 return intr;
             }
         }
@@ -386,5 +566,6 @@ Intersection KdTreePrimitiveManager::intersectWithPrims(const Ray& ray) const {
         ex = stack[en].prev;
     }
 
+    record();
     return {};
 }
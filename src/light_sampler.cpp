@@ -0,0 +1,18 @@
+#include "light_sampler.h"
+
+#include "light.h"
+
+void LightSampler::build(const std::vector<std::unique_ptr<Light>>& lights) {
+    std::vector<floating> powers;
+    powers.reserve(lights.size());
+    m_lights.clear();
+    for (const auto& light : lights) {
+        m_lights.push_back(light.get());
+        powers.push_back(light->power());
+    }
+
+    m_table.build(powers);
+    for (size_t i = 0; i < m_lights.size(); ++i) {
+        m_lights[i]->setSamplingPr(m_table.pr(i));
+    }
+}
@@ -1,9 +1,16 @@
+#include "checkpoint.h"
+#include "float_surface.h"
 #include "kdtree_primitive_manager.h"
 #include "naive_primitive_manager.h"
 #include "nff_scene_reader.h"
+#include "obj_scene_reader.h"
+#include "parser.h"
 #include "pathtracer.h"
 #include "raytracer.h"
+#include "render_server.h"
+#include "sampler.h"
 #include "scene.h"
+#include "scene_cache.h"
 #include "tga_surface.h"
 #include "vcm.h"
 
@@ -12,12 +19,121 @@
 #endif
 
 #include <boost/program_options.hpp>
+#include <cstdio>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <sstream>
 #include <string>
+#include <vector>
 
 namespace po = boost::program_options;
 
+/// Reads a duration with an optional unit, seconds by default.
+bool parseDuration(const std::string& str, floating& seconds) {
+    char*      end = nullptr;
+    const auto value = strtod(str.c_str(), &end);
+    if (end == str.c_str() || !(value > 0.0))
+        return false;
+
+    const std::string unit = end;
+    if (unit == "m")
+        seconds = value * 60;
+    else if (unit == "h")
+        seconds = value * 3600;
+    else if (unit.empty() || unit == "s")
+        seconds = value;
+    else
+        return false;
+
+    return true;
+}
+
+/// Parses "K/N" with K < N.
+bool parseShard(const std::string& str, size_t& shard, size_t& shards) {
+    char rest;
+    return sscanf(str.c_str(), "%zu/%zu%c", &shard, &shards, &rest) == 2 &&
+           shard < shards;
+}
+
+/// Inserts the zero padded @a index before the extension of @a file.
+std::string numberedFileName(const std::string& file, size_t index) {
+    char number[16];
+    snprintf(number, sizeof(number), "%04zu", index);
+    auto dot = file.rfind('.');
+    if (dot == std::string::npos || file.find('/', dot) != std::string::npos)
+        dot = file.size();
+    return file.substr(0, dot) + number + file.substr(dot);
+}
+
+/// Every parameter of the view exactly, for the job of a checkpoint.
+std::string describeView(const Camera::Parameters& view) {
+    std::ostringstream os;
+    os.precision(std::numeric_limits<floating>::max_digits10);
+    os << "from " << view.from.x << ' ' << view.from.y << ' ' << view.from.z
+       << " at " << view.at.x << ' ' << view.at.y << ' ' << view.at.z
+       << " up " << view.up.x << ' ' << view.up.y << ' ' << view.up.z
+       << " angle " << view.fov << " hither " << view.hither << " resolution "
+       << view.width << ' ' << view.height << " aperture " << view.aperture
+       << " focus " << view.focus;
+    return os.str();
+}
+
+/// Attaches the selected images, numbered by @a index if @a numbered.
+void attachOutputs(Scene& scene, const po::variables_map& vm, bool numbered,
+                   size_t index) {
+#ifdef HAVE_GD_SUPPORT_PNG
+    if (vm.count("png")) {
+        std::string out_file = vm["png"].as<std::string>();
+        if (numbered)
+            out_file = numberedFileName(out_file, index);
+        scene.attachSurface(new PngSurface(out_file));
+    }
+#endif
+
+    if (vm.count("tga")) {
+        std::string out_file = vm["tga"].as<std::string>();
+        if (numbered)
+            out_file = numberedFileName(out_file, index);
+        scene.attachSurface(new TgaSurface(out_file));
+    }
+
+    if (vm.count("pfm")) {
+        std::string out_file = vm["pfm"].as<std::string>();
+        if (numbered)
+            out_file = numberedFileName(out_file, index);
+        scene.attachSurface(new PfmSurface(out_file));
+    }
+
+    if (vm.count("exr")) {
+        std::string out_file = vm["exr"].as<std::string>();
+        if (numbered)
+            out_file = numberedFileName(out_file, index);
+        scene.attachSurface(new ExrSurface(out_file));
+    }
+}
+
+/// Writes the statistics of the last run if asked, numbered like the images.
+bool writeStatistics(const Scene& scene, const po::variables_map& vm,
+                     bool numbered, size_t index) {
+    if (vm.count("stats") == 0)
+        return true;
+
+    std::string out_file = vm["stats"].as<std::string>();
+    if (numbered)
+        out_file = numberedFileName(out_file, index);
+    std::ofstream out{out_file};
+    scene.statistics().writeJson(out);
+    out.close();
+    if (!out) {
+        std::cerr << "Unable to write statistics " << out_file << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 void parseCommandLine(int argc, char** argv, po::options_description& desc, po::variables_map& vm) {
   desc.add_options()
     ("help,h",                              "Output this help message")
@@ -25,10 +141,31 @@ void parseCommandLine(int argc, char** argv, po::options_description& desc, po::
     ("png",       po::value<std::string>(), "Output PNG image")
 #endif
     ("tga",       po::value<std::string>(), "Output TGA image")
+    ("pfm",       po::value<std::string>(), "Output linear HDR image in PFM format")
+    ("exr",       po::value<std::string>(), "Output linear HDR image in OpenEXR format")
+    ("stats",     po::value<std::string>(), "Write the ray, traversal and path counters of the render as JSON")
     ("bpt",                                 "Use bidirection path tracer")
     ("vcm",                                 "Use vertex connecting and merging")
+    ("lvc",       po::value<size_t>(),      "Connect VCM camera vertices to this many cached light vertices")
     ("samples,s", po::value<size_t>(),      "Number of samples per pixel")
-    ("input,i",   po::value<std::string>(), "Input NFF file");
+    ("time",      po::value<std::string>(), "Stop rendering after this long (30s, 5m or 1h)")
+    ("noise",     po::value<floating>(),    "Stop rendering once the estimated noise is at most this (0.01 or so)")
+    ("adaptive",                            "Make --noise (0.01 by default) the target of every pixel and stop sampling the pixels that reach it")
+    ("sampler",   po::value<std::string>(), "Sample sequence: sobol (default), pmj02, halton or random")
+    ("seed",      po::value<uint64_t>(),    "Seed of the samples, renders with different seeds are independent")
+    ("deterministic",                       "Give the same image regardless of the number of threads")
+    ("checkpoint", po::value<std::string>(), "Save the sums of the image to this file every --checkpoint-interval")
+    ("checkpoint-interval", po::value<std::string>(), "Time between checkpoints (5m by default)")
+    ("resume",                              "Continue from the checkpoint if there is one")
+    ("shard",     po::value<std::string>(), "Render only shard K of N (given as K/N) of the samples into the checkpoint")
+    ("merge",     po::value<std::vector<std::string>>()->multitoken(), "Write the image of these checkpoints of every shard of a render")
+    ("rr-depth",  po::value<size_t>(),      "Path length after which Russian roulette starts")
+    ("rr-min-pr", po::value<floating>(),    "Lower bound of Russian roulette survival probability")
+    ("cache",                               "Cache parsed scene and kd-tree next to the input file")
+    ("frames",    po::value<size_t>(),      "Render this many frames of the animation, numbered before the extension")
+    ("views",     po::value<std::string>(), "Render every view (\"v\" statement) of this file, numbered before the extension")
+    ("serve",     po::value<std::string>(), "Keep scenes loaded and render requests from this unix domain socket")
+    ("input,i",   po::value<std::string>(), "Input NFF or OBJ file");
 
   po::positional_options_description p;
   p.add("input", -1);
@@ -40,7 +177,7 @@ void parseCommandLine(int argc, char** argv, po::options_description& desc, po::
 /**
  * TODO:
  * Major:
- *  - Improved input format (.obj, .3ds, or custom blender exporter?)
+ *  - Improved input format (.3ds, or custom blender exporter?)
  *
  * Minor:
  *  - All of the init-s are a code smell... Initialization should always be done in the class constructor.
@@ -61,9 +198,54 @@ int main(int argc, char** argv) {
         return EXIT_SUCCESS;
     }
 
+    /******************************
+     * Configure path termination *
+     ******************************/
+
+    {
+        auto rr = RussianRoulette{};
+        const auto startDepth = vm.count("rr-depth")
+                                    ? vm["rr-depth"].as<size_t>()
+                                    : rr.startDepth();
+        const auto minSurvivalPr = vm.count("rr-min-pr")
+                                       ? vm["rr-min-pr"].as<floating>()
+                                       : rr.minSurvivalPr();
+        scene.setRussianRoulette(RussianRoulette{startDepth, minSurvivalPr});
+    }
+
+    /******************
+     * Serve requests *
+     ******************/
+
+    if (vm.count("serve")) {
+        RenderServer server{vm["serve"].as<std::string>(),
+                            scene.russianRoulette(), vm.count("cache") != 0};
+        return server.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    /****************
+     * Merge shards *
+     ****************/
+
+    if (vm.count("merge")) {
+        attachOutputs(scene, vm, false, 0);
+        const auto ok = mergeShards(
+            vm["merge"].as<std::vector<std::string>>(), scene.surfaces());
+        scene.detachSurfaces();
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     if (vm.count("input")) {
         std::string inp_file = vm["input"].as<std::string>();
-        scene.setSceneReader(new NFFSceneReader(inp_file.c_str()));
+        const auto  is_obj =
+            inp_file.size() >= 4 &&
+            inp_file.compare(inp_file.size() - 4, 4, ".obj") == 0;
+        if (is_obj)
+            scene.setSceneReader(new OBJSceneReader(inp_file.c_str()));
+        else
+            scene.setSceneReader(new NFFSceneReader(inp_file.c_str()));
+        if (vm.count("cache"))
+            scene.setCacheFile(inp_file + ".cache");
     } else {
         std::cerr << "No input file specified!" << std::endl;
         std::cerr << desc << std::endl;
@@ -80,43 +262,219 @@ int main(int argc, char** argv) {
         return EXIT_FAILURE;
     }
 
+    if (vm.count("lvc") != 0 && vm.count("vcm") == 0) {
+        std::cerr << "Light vertex cache is only supported by VCM." << std::endl;
+        std::cerr << desc << std::endl;
+        return EXIT_FAILURE;
+    }
+
     if (vm.count("bpt") != 0) {
         scene.setRenderer(new Pathtracer(scene));
     } else if (vm.count("vcm") != 0) {
-        scene.setRenderer(new VCMRenderer(scene));
+        const auto lvc = vm.count("lvc") ? vm["lvc"].as<size_t>() : 0;
+        scene.setRenderer(new VCMRenderer(scene, lvc));
     } else {
         scene.setRenderer(new Raytracer(scene));
     }
 
+    if (vm.count("sampler") != 0) {
+        const auto sampler = makeSampler(vm["sampler"].as<std::string>());
+        if (sampler == nullptr) {
+            std::cerr << "Unknown sampler." << std::endl;
+            std::cerr << desc << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        scene.setSampler(sampler);
+    }
+
+    if (vm.count("seed") != 0)
+        scene.setSeed(vm["seed"].as<uint64_t>());
+
+    if (vm.count("deterministic") != 0) {
+        if (vm.count("time") != 0 || vm.count("adaptive") != 0) {
+            std::cerr << "Deterministic renders can not have a time limit or "
+                         "adaptive sampling." << std::endl;
+            std::cerr << desc << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        scene.setDeterministic(true);
+    }
+
     /*************************
      * Set number of samples *
      *************************/
 
-    if (vm.count("samples") == 0) {
-        scene.setSamples(1);
-    } else {
+    const bool progressive = vm.count("time") != 0 ||
+                             vm.count("noise") != 0 ||
+                             vm.count("adaptive") != 0;
+    if (vm.count("samples") != 0) {
         scene.setSamples(vm["samples"].as<size_t>());
+    } else if (progressive) {
+        // Samples are only limited by the stopping criteria.
+        scene.setSamples(std::numeric_limits<size_t>::max());
+    } else {
+        scene.setSamples(1);
+    }
+
+    if (vm.count("time")) {
+        floating seconds;
+        if (!parseDuration(vm["time"].as<std::string>(), seconds)) {
+            std::cerr << "Invalid time limit." << std::endl;
+            std::cerr << desc << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        scene.setTimeLimit(seconds);
+    }
+
+    if (vm.count("noise")) {
+        const auto noise = vm["noise"].as<floating>();
+        if (!(noise > 0.0)) {
+            std::cerr << "Noise target must be positive." << std::endl;
+            std::cerr << desc << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        // Adaptive sampling stops once every pixel is below the target.
+        if (vm.count("adaptive") == 0)
+            scene.setNoiseTarget(noise);
+    }
+
+    if (vm.count("adaptive")) {
+        scene.setAdaptiveSampling(
+            vm.count("noise") ? vm["noise"].as<floating>() : 0.01);
+    }
+
+    /***************
+     * Checkpoints *
+     ***************/
+
+    floating checkpointInterval = 300.0;
+    if (vm.count("checkpoint-interval") &&
+        !parseDuration(vm["checkpoint-interval"].as<std::string>(),
+                       checkpointInterval)) {
+        std::cerr << "Invalid checkpoint interval." << std::endl;
+        std::cerr << desc << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (vm.count("resume") != 0 && vm.count("checkpoint") == 0) {
+        std::cerr << "Can only resume from a checkpoint." << std::endl;
+        std::cerr << desc << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (vm.count("checkpoint") != 0 && vm.count("adaptive") != 0) {
+        std::cerr << "Adaptive sampling can not be checkpointed." << std::endl;
+        std::cerr << desc << std::endl;
+        return EXIT_FAILURE;
     }
 
+    size_t shard = 0, shards = 1;
+    if (vm.count("shard")) {
+        if (!parseShard(vm["shard"].as<std::string>(), shard, shards)) {
+            std::cerr << "Invalid shard." << std::endl;
+            std::cerr << desc << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (vm.count("checkpoint") == 0) {
+            std::cerr << "Shards are saved to a checkpoint." << std::endl;
+            std::cerr << desc << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        scene.setShard(shard, shards);
+    }
+
+    // Checkpoints are only loaded back by a render of the same job, of the
+    // same scene contents and the same view.
+    const auto  input = vm["input"].as<std::string>();
+    std::string job =
+        input + " source " + std::to_string(SceneCache::hashSource(input));
+    job += vm.count("bpt") ? " bpt" : vm.count("vcm") ? " vcm" : " whitted";
+    if (vm.count("lvc"))
+        job += " lvc " + std::to_string(vm["lvc"].as<size_t>());
+    if (vm.count("sampler"))
+        job += " sampler " + vm["sampler"].as<std::string>();
+    if (vm.count("seed"))
+        job += " seed " + std::to_string(vm["seed"].as<uint64_t>());
+    job += " rr " + std::to_string(scene.russianRoulette().startDepth()) +
+           " " + std::to_string(scene.russianRoulette().minSurvivalPr());
+
     /*****************
      * Select output *
      *****************/
 
-#ifdef HAVE_GD_SUPPORT_PNG
-    if (vm.count("png")) {
-        std::string out_file = vm["png"].as<std::string>();
-        scene.attachSurface(new PngSurface(out_file));
+    if (vm.count("frames") != 0 && vm.count("views") != 0) {
+        std::cerr << "Can only select one of frames and views." << std::endl;
+        std::cerr << desc << std::endl;
+        return EXIT_FAILURE;
     }
-#endif
 
-    if (vm.count("tga")) {
-        std::string out_file = vm["tga"].as<std::string>();
-        scene.attachSurface(new TgaSurface(out_file));
+    std::vector<Camera::Parameters> views;
+    if (vm.count("views") != 0) {
+        const auto views_file = vm["views"].as<std::string>();
+        // Parser reports why the file can not be read.
+        if (!nff2views(views, views_file.c_str()))
+            return EXIT_FAILURE;
+
+        if (views.empty()) {
+            std::cerr << "No views in \"" << views_file << "\"." << std::endl;
+            return EXIT_FAILURE;
+        }
     }
 
+    const bool numbered = vm.count("frames") != 0 || !views.empty();
+    const auto attachSurfaces = [&](size_t index) {
+        attachOutputs(scene, vm, numbered, index);
+        if (vm.count("checkpoint")) {
+            std::string file = vm["checkpoint"].as<std::string>();
+            if (numbered)
+                file = numberedFileName(file, index);
+            scene.setCheckpoint(
+                new Checkpoint{file,
+                               job + " image " + std::to_string(index) + " " +
+                                   describeView(scene.camera().parameters()),
+                               shard, shards},
+                checkpointInterval, vm.count("resume") != 0);
+        }
+    };
+
     // TODO: allow selection of various primitive managers
     scene.setPrimitiveManager(new KdTreePrimitiveManager());
-    scene.init();
-    scene.run();
+    std::string error;
+    if (!scene.init(error)) {
+        std::cerr << error << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!numbered) {
+        attachSurfaces(0);
+        scene.run();
+        return writeStatistics(scene, vm, false, 0) ? EXIT_SUCCESS
+                                                    : EXIT_FAILURE;
+    }
+
+    // Images share the parsed scene, its kd-tree and the rendering threads,
+    // only the camera and the animated parts change.
+    const auto count = views.empty() ? vm["frames"].as<size_t>()
+                                     : views.size();
+    for (size_t i = 0; i < count; ++i) {
+        if (views.empty()) {
+            scene.setTime(i);
+        } else {
+            scene.camera().setup(views[i]);
+        }
+
+        attachSurfaces(i);
+        scene.run();
+        scene.detachSurfaces();
+        if (!writeStatistics(scene, vm, true, i))
+            return EXIT_FAILURE;
+    }
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,44 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& fname)
+    : m_data{nullptr}
+    , m_size{0}
+    , m_open{false}
+{
+    const auto fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return;
+    }
+
+    m_size = st.st_size;
+    if (m_size > 0) {
+        auto addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            m_size = 0;
+            close(fd);
+            return;
+        }
+
+        madvise(addr, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(addr);
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    m_open = true;
+}
+
+MappedFile::~MappedFile() {
+    if (m_data != nullptr)
+        munmap(const_cast<char*>(m_data), m_size);
+}
@@ -5,11 +5,16 @@
 #include "primitive.h"
 #include "ray.h"
 #include "scene_sphere.h"
+#include "statistics.h"
 
-NaivePrimitiveManager::~NaivePrimitiveManager() {
+NaivePrimitiveManager::~NaivePrimitiveManager() { clear(); }
+
+void NaivePrimitiveManager::clear() {
     for (auto p : m_prims) {
         delete p;
     }
+
+    m_prims.clear();
 }
 
 void NaivePrimitiveManager::setSceneSphere(SceneSphere& sceneSphere) const {
@@ -39,5 +44,7 @@ Intersection NaivePrimitiveManager::intersectWithPrims(const Ray& ray) const {
         p->intersect(ray, intr);
     }
 
+    threadStatistics().primitivesTested += m_prims.size();
+
     return intr;
 }
@@ -2,9 +2,9 @@
 #include "parser.h"
 #include "scene.h"
 
-SceneReader::Status NFFSceneReader::init(Scene& scene) const {
-    int r = nff2scene(scene, fname().c_str());
-    if (!r)
+SceneReader::Status NFFSceneReader::init(Scene& scene,
+                                         std::string& error) const {
+    if (!nff2scene(scene, fname().c_str(), error))
         return SceneReader::E_OTHER;
     return SceneReader::OK;
 }
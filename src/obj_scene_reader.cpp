@@ -0,0 +1,762 @@
+#include "obj_scene_reader.h"
+
+#include "background_light.h"
+#include "common.h"
+#include "geometry.h"
+#include "mapped_file.h"
+#include "material.h"
+#include "pfm_reader.h"
+#include "scene.h"
+#include "surface.h"
+#include "texture.h"
+#include "tga_reader.h"
+#include "thread_pool.h"
+#include "tokenizer.h"
+#include "triangle_light.h"
+#include "triangle_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace /* anonymous */ {
+
+/// Material selected by "usemtl".
+struct ObjMaterial {
+    material_index_t material;
+    texture_index_t  texture;  ///< Diffuse map, -1 if there is none.
+    Colour           emission; ///< Faces are lights if not black.
+};
+
+using ObjMaterials = std::unordered_map<std::string, ObjMaterial>;
+
+/// Vertex of a face as zero based indices to vertex data, -1 if missing.
+struct Corner {
+    int32_t position;
+    int32_t uv;
+    int32_t normal;
+};
+
+struct Face {
+    uint32_t           first; ///< Index of the first corner.
+    uint32_t           count;
+    const ObjMaterial* material;
+};
+
+/// Vertex data of the whole file, chunks fill in their own parts.
+struct ObjVertices {
+    std::vector<Point>   positions;
+    std::vector<Vector2> uvs;
+    std::vector<Vector>  normals;
+};
+
+/**
+ * Part of the OBJ file that is parsed independently of the others. The
+ * prescan counts the vertex data of every chunk, so that chunks know the
+ * global index of their first vertex, and records material libraries and
+ * the material in use at the end of the chunk.
+ */
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+
+    size_t                   positionCount;
+    size_t                   uvCount;
+    size_t                   normalCount;
+    std::vector<std::string> libraries;
+    std::string              lastMaterial; ///< Empty if there is no "usemtl".
+
+    size_t      positions; ///< Index of the first position of the chunk.
+    size_t      uvs;       ///< Index of the first uv of the chunk.
+    size_t      normals;   ///< Index of the first normal of the chunk.
+    std::string material;  ///< Material in use at the start of the chunk.
+
+    std::vector<Corner> corners;
+    std::vector<Face>   faces;
+
+    std::vector<const Primitive*> prims;
+    std::vector<Light*>           lights;
+
+    /// Faces of the chunk, indexed by having normals plus twice by having
+    /// uv-coordinates.
+    std::unique_ptr<TriangleMesh> meshes[4];
+
+    std::string error; ///< First error of the chunk, parsing stops at it.
+};
+
+std::string directory(const std::string& fname) {
+    return fname.substr(0, fname.find_last_of('/') + 1);
+}
+
+bool hasSuffix(const std::string& s, const char* suffix) {
+    const auto n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+texture_index_t loadTexture(Scene& scene, const std::string& fname) {
+    const auto tga = hasSuffix(fname, ".tga");
+    if (!tga && !hasSuffix(fname, ".pfm")) {
+        fprintf(stderr, "Unsupported texture \"%s\" is ignored.\n",
+                fname.c_str());
+        return -1;
+    }
+
+    scene.addDependency(fname);
+    auto texture = tga ? readTexture(fname) : readPfm(fname);
+    if (texture.width() == 0) {
+        fprintf(stderr, "Texture \"%s\" is ignored.\n", fname.c_str());
+        return -1;
+    }
+
+    return scene.textures().registerTexture(std::move(texture));
+}
+
+/**
+ * MTL statements are mapped to materials as follows: Kd is the colour, the
+ * luminance of Ks is the specular coefficient, 1 - d (or Tr) the
+ * transmittance and the rest is diffuse. Ns is the Phong exponent and Ni the
+ * index of refraction. Only the diffuse map is supported. Parsing stops at
+ * the first error.
+ */
+class MTLParser {
+public: /* Methods: */
+
+    MTLParser(Scene& scene, const MappedFile& file, std::string dir,
+              ObjMaterials& materials)
+        : m_scene(scene)
+        , m_tok{file.begin(), file.end()}
+        , m_dir{std::move(dir)}
+        , m_materials(materials)
+    {
+        reset();
+    }
+
+    void parse() {
+        while (m_error.empty() && !m_tok.atEnd()) {
+            const auto cmd = m_tok.word();
+            if (cmd == "newmtl") {
+                flush();
+                reset();
+                m_name = m_tok.word().str();
+            } else if (cmd == "Kd") {
+                m_kd = colour();
+            } else if (cmd == "Ks") {
+                m_ks = colour();
+            } else if (cmd == "Ke") {
+                m_ke = colour();
+            } else if (cmd == "Ns") {
+                number(m_ns);
+            } else if (cmd == "Ni") {
+                number(m_ni);
+            } else if (cmd == "d") {
+                number(m_d);
+            } else if (cmd == "Tr") {
+                number(m_d);
+                m_d = 1.0 - m_d;
+            } else if (cmd == "map_Kd") {
+                // Options precede the file name.
+                Token name = m_tok.word();
+                while (!m_tok.atLineEnd())
+                    name = m_tok.word();
+                m_map = name.str();
+            }
+
+            m_tok.skipLine();
+        }
+
+        if (m_error.empty())
+            flush();
+    }
+
+    /// First error, empty if there was none.
+    const std::string& errorMessage() const { return m_error; }
+
+private: /* Methods: */
+
+    void error(const std::string& msg) {
+        if (m_error.empty())
+            m_error = msg + " (line " + std::to_string(m_tok.line()) + ")";
+    }
+
+    void number(floating& out) {
+        if (!m_tok.number(out))
+            error("MTL syntax error");
+    }
+
+    Colour colour() {
+        floating v[3];
+        if (!m_tok.number(v[0])) {
+            error("MTL colour syntax error");
+            return Colour{0, 0, 0};
+        }
+
+        // A single value is grey.
+        v[1] = v[2] = v[0];
+        m_tok.numbers(v + 1, 2);
+        return Colour{v[0], v[1], v[2]};
+    }
+
+    void reset() {
+        m_name.clear();
+        m_kd = Colour{0.8, 0.8, 0.8};
+        m_ks = Colour{0, 0, 0};
+        m_ke = Colour{0, 0, 0};
+        m_ns = 1.0;
+        m_ni = 1.0;
+        m_d = 1.0;
+        m_map.clear();
+    }
+
+    void flush() {
+        if (m_name.empty())
+            return;
+
+        const auto ks = clamp(luminance(m_ks), 0, 1);
+        const auto t = clamp(1.0 - m_d, 0, 1);
+        const auto kd = std::max(1.0 - ks - t, 0.0);
+        const auto index = m_scene.materials().registerMaterial(
+            Material{m_kd, kd, ks, t, m_ni, std::max(m_ns, 1.0)});
+        const texture_index_t texture =
+            m_map.empty() ? -1 : loadTexture(m_scene, m_dir + m_map);
+        m_materials[m_name] = ObjMaterial{index, texture, m_ke};
+    }
+
+private: /* Fields: */
+    Scene&        m_scene;
+    Tokenizer     m_tok;
+    std::string   m_dir;
+    ObjMaterials& m_materials;
+    std::string   m_name;
+    Colour        m_kd;
+    Colour        m_ks;
+    Colour        m_ke;
+    floating      m_ns;
+    floating      m_ni;
+    floating      m_d;
+    std::string   m_map;
+    std::string   m_error;
+};
+
+/**
+ * Parses a chunk of OBJ from memory mapped file. In prescan mode only counts
+ * the vertex data and notes material statements, otherwise stores the
+ * vertex data to its place and collects the faces of the chunk. Parsing
+ * stops at the first error, which is recorded to the chunk.
+ */
+class OBJParser {
+public: /* Methods: */
+
+    OBJParser(const char* origin, ObjChunk& chunk, bool prescan,
+              ObjVertices* vertices = nullptr,
+              const ObjMaterials* materials = nullptr,
+              const ObjMaterial* defaultMaterial = nullptr)
+        : m_chunk(chunk)
+        , m_tok{chunk.begin, chunk.end, origin}
+        , m_prescan{prescan}
+        , m_vertices{vertices}
+        , m_materials{materials}
+        , m_material{defaultMaterial}
+        , m_position{chunk.positions}
+        , m_uv{chunk.uvs}
+        , m_normal{chunk.normals}
+    {
+        if (!m_prescan && !chunk.material.empty())
+            useMaterial(chunk.material);
+    }
+
+    void parse() {
+        while (m_chunk.error.empty() && !m_tok.atEnd()) {
+            const auto cmd = m_tok.word();
+            if (cmd == "v")
+                doPosition();
+            else if (cmd == "vt")
+                doUV();
+            else if (cmd == "vn")
+                doNormal();
+            else if (cmd == "f")
+                doFace();
+            else if (cmd == "usemtl")
+                doUseMaterial();
+            else if (cmd == "mtllib")
+                doMaterialLibrary();
+
+            // Groups, smoothing groups, lines and so on are ignored.
+            m_tok.skipLine();
+        }
+    }
+
+private: /* Methods: */
+
+    void error(const std::string& msg) const {
+        if (m_chunk.error.empty())
+            m_chunk.error =
+                msg + " (line " + std::to_string(m_tok.line()) + ")";
+    }
+
+    void doPosition() {
+        if (m_prescan) {
+            ++m_chunk.positionCount;
+            return;
+        }
+
+        floating v[3];
+        if (!m_tok.numbers(v, 3))
+            return error("OBJ vertex syntax error");
+        m_vertices->positions[m_position++] = Point{v[0], v[1], v[2]};
+    }
+
+    void doUV() {
+        if (m_prescan) {
+            ++m_chunk.uvCount;
+            return;
+        }
+
+        floating v[2] = {0.0, 0.0};
+        if (!m_tok.number(v[0]))
+            return error("OBJ texture coordinate syntax error");
+        m_tok.number(v[1]);
+        m_vertices->uvs[m_uv++] = Vector2{v[0], v[1]};
+    }
+
+    void doNormal() {
+        if (m_prescan) {
+            ++m_chunk.normalCount;
+            return;
+        }
+
+        floating v[3];
+        if (!m_tok.numbers(v, 3))
+            return error("OBJ normal syntax error");
+        m_vertices->normals[m_normal++] = Vector{v[0], v[1], v[2]};
+    }
+
+    void doUseMaterial() {
+        const auto name = m_tok.word().str();
+        if (m_prescan) {
+            m_chunk.lastMaterial = name;
+            return;
+        }
+
+        useMaterial(name);
+    }
+
+    void doMaterialLibrary() {
+        while (!m_tok.atLineEnd()) {
+            const auto name = m_tok.word();
+            if (m_prescan)
+                m_chunk.libraries.push_back(name.str());
+        }
+    }
+
+    void useMaterial(const std::string& name) {
+        const auto it = m_materials->find(name);
+        if (it == m_materials->end()) {
+            fprintf(stderr, "Unknown material \"%s\" (line %zu)\n",
+                    name.c_str(), m_tok.line());
+            return;
+        }
+
+        m_material = &it->second;
+    }
+
+    void doFace() {
+        if (m_prescan)
+            return;
+
+        const auto first = m_chunk.corners.size();
+        while (m_chunk.error.empty() && !m_tok.atLineEnd())
+            m_chunk.corners.push_back(corner());
+
+        const auto count = m_chunk.corners.size() - first;
+        if (!m_chunk.error.empty())
+            return;
+        if (count < 3)
+            return error("OBJ face needs at least three vertices");
+
+        m_chunk.faces.push_back(
+            Face{(uint32_t)first, (uint32_t)count, m_material});
+    }
+
+    // Corners are "v", "v/vt", "v//vn" or "v/vt/vn".
+    Corner corner() {
+        auto c = Corner{-1, -1, -1};
+        int  index;
+        if (!m_tok.number(index)) {
+            error("OBJ face syntax error");
+            return c;
+        }
+
+        c.position = resolve(index, m_position);
+
+        if (m_tok.acceptChar('/')) {
+            if (m_tok.number(index))
+                c.uv = resolve(index, m_uv);
+            if (m_tok.acceptChar('/')) {
+                if (!m_tok.number(index)) {
+                    error("OBJ face syntax error");
+                    return c;
+                }
+
+                c.normal = resolve(index, m_normal);
+            }
+        }
+
+        return c;
+    }
+
+    /// Indices start from one, negative indices are relative to the end.
+    int32_t resolve(int index, size_t count) const {
+        const auto result = index > 0 ? index - 1 : (long)count + index;
+        if (index == 0 || result < 0)
+            error("OBJ face refers to a missing vertex");
+        return (int32_t)result;
+    }
+
+private: /* Fields: */
+    ObjChunk&           m_chunk;
+    Tokenizer           m_tok;
+    const bool          m_prescan;
+    ObjVertices*        m_vertices;
+    const ObjMaterials* m_materials;
+    const ObjMaterial*  m_material;
+    size_t              m_position; ///< Global index of the next position.
+    size_t              m_uv;
+    size_t              m_normal;
+};
+
+/**
+ * Mesh that takes over the vertex data of the whole file if every corner
+ * refers to its position, uv-coordinates and normal by the same index, all
+ * corners have the same kind of data and the faces share their vertices.
+ * Faces then refer to the vertex data directly instead of copying it to the
+ * meshes of the chunks. Files that list the vertices of every face anew are
+ * copied, which merges the equal vertices. @retval nullptr if the file does
+ * not qualify.
+ */
+std::unique_ptr<TriangleMesh> shareVertices(
+    const std::vector<ObjChunk>& chunks, ObjVertices& vertices) {
+    std::unique_ptr<TriangleMesh> mesh;
+    const Corner*                 first = nullptr;
+    size_t                        corners = 0;
+    for (const auto& chunk : chunks) {
+        corners += chunk.corners.size();
+        if (first == nullptr && !chunk.corners.empty())
+            first = &chunk.corners.front();
+        for (const auto& c : chunk.corners) {
+            if ((size_t)c.position >= vertices.positions.size() ||
+                (c.uv >= 0) != (first->uv >= 0) ||
+                (c.normal >= 0) != (first->normal >= 0) ||
+                (c.uv >= 0 && c.uv != c.position) ||
+                (c.normal >= 0 && c.normal != c.position))
+                return mesh;
+        }
+    }
+
+    if (first == nullptr || corners < 2 * vertices.positions.size())
+        return mesh;
+
+    const bool hasUVs = first->uv >= 0;
+    const bool hasNormals = first->normal >= 0;
+    const auto count = vertices.positions.size();
+    if ((hasUVs && vertices.uvs.size() != count) ||
+        (hasNormals && vertices.normals.size() != count))
+        return mesh;
+
+    mesh.reset(new TriangleMesh{hasNormals, hasUVs});
+    mesh->assign(std::move(vertices.positions), std::move(vertices.normals),
+                 std::move(vertices.uvs));
+    vertices = ObjVertices{};
+    return mesh;
+}
+
+/**
+ * Copies the vertices of a face to the mesh of the chunk that has the same
+ * kind of data. @retval nullptr if the face refers to a missing vertex.
+ */
+TriangleMesh* copyFace(const ObjVertices& vertices, const Corner* corners,
+                       uint32_t count, ObjChunk& chunk,
+                       std::vector<uint32_t>& indices) {
+    bool hasUVs = true, hasNormals = true;
+    for (uint32_t i = 0; i < count; ++i) {
+        const auto& c = corners[i];
+        if ((size_t)c.position >= vertices.positions.size() ||
+            c.uv >= (int64_t)vertices.uvs.size() ||
+            c.normal >= (int64_t)vertices.normals.size())
+            return nullptr;
+
+        hasUVs = hasUVs && c.uv >= 0;
+        hasNormals = hasNormals && c.normal >= 0;
+    }
+
+    auto& mesh = chunk.meshes[hasNormals + 2 * hasUVs];
+    if (!mesh)
+        mesh.reset(new TriangleMesh{hasNormals, hasUVs});
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const auto& c = corners[i];
+        const auto  normal =
+            hasNormals ? vertices.normals[c.normal] : Vector{0, 0, 0};
+        const auto uv = hasUVs ? vertices.uvs[c.uv] : Vector2{0, 0};
+        indices[i] =
+            mesh->addVertex(vertices.positions[c.position], normal, uv);
+    }
+
+    return mesh.get();
+}
+
+/**
+ * Stores the faces of the chunk to its meshes, or refers them to the
+ * @a shared mesh, and creates the primitives. The faces are released.
+ */
+void buildChunk(Scene& scene, const ObjVertices& vertices,
+                TriangleMesh* shared, ObjChunk& chunk) {
+    std::vector<uint32_t> indices;
+    for (const auto& face : chunk.faces) {
+        const auto    corners = &chunk.corners[face.first];
+        TriangleMesh* mesh = shared;
+        indices.resize(face.count);
+        if (mesh != nullptr) {
+            for (uint32_t i = 0; i < face.count; ++i)
+                indices[i] = corners[i].position;
+        } else {
+            mesh = copyFace(vertices, corners, face.count, chunk, indices);
+            if (mesh == nullptr) {
+                chunk.error = "OBJ face refers to a missing vertex";
+                return;
+            }
+        }
+
+        const auto& material = *face.material;
+        const auto  emissive = luminance(material.emission) > 0.0;
+        for (uint32_t i = 1; i + 1 < face.count; ++i) {
+            const auto& p0 = mesh->position(indices[0]);
+            const auto& p1 = mesh->position(indices[i]);
+            const auto& p2 = mesh->position(indices[i + 1]);
+            // Degenerate emitters can not be hit either.
+            if (emissive && !TriangleLight::hasArea(p0, p1, p2))
+                continue;
+
+            Primitive* prim = new MeshTriangle{*mesh, indices[0], indices[i],
+                                               indices[i + 1]};
+            if (emissive) {
+                Light* light = new TriangleLight{
+                    scene.sceneSphere(), material.emission, p0, p1, p2};
+                prim->setMaterial(Materials::lightMaterial());
+                prim->setLight(light);
+                chunk.lights.push_back(light);
+            } else {
+                prim->setMaterial(material.material);
+                if (mesh->hasUVs() && material.texture >= 0)
+                    prim->setTexture(material.texture);
+            }
+
+            chunk.prims.push_back(prim);
+        }
+    }
+
+    for (auto& mesh : chunk.meshes) {
+        if (mesh)
+            mesh->finish();
+    }
+
+    std::vector<Corner>().swap(chunk.corners);
+    std::vector<Face>().swap(chunk.faces);
+}
+
+/// Chunks are split at line boundaries.
+std::vector<ObjChunk> splitChunks(const char* begin, const char* end) {
+    const size_t size = end - begin;
+    const size_t count = std::max(size / RAY_PARSE_CHUNK_SIZE, size_t{1});
+
+    std::vector<ObjChunk> chunks;
+    auto                  start = begin;
+    for (size_t i = 1; i <= count; ++i) {
+        auto p = i == count ? end : std::max(begin + i * size / count, start);
+        if (p != end && p != start && p[-1] != '\n') {
+            p = static_cast<const char*>(memchr(p, '\n', end - p));
+            p = p == nullptr ? end : p + 1;
+        }
+
+        if (p == start)
+            continue;
+
+        chunks.emplace_back();
+        chunks.back().begin = start;
+        chunks.back().end = p;
+        start = p;
+    }
+
+    return chunks;
+}
+
+/// Frees what the chunks created outside of the scene and reports the first
+/// error. @retval false if a chunk has an error.
+bool checkChunks(std::vector<ObjChunk>& chunks, std::string& error) {
+    const auto failed = std::find_if(
+        chunks.begin(), chunks.end(),
+        [](const ObjChunk& chunk) { return !chunk.error.empty(); });
+    if (failed == chunks.end())
+        return true;
+
+    error = failed->error;
+    for (const auto& chunk : chunks) {
+        for (auto prim : chunk.prims)
+            delete prim;
+        for (auto light : chunk.lights)
+            delete light;
+    }
+
+    return false;
+}
+
+/// Looks at the model along the negative z-axis from far enough to see all.
+void setupCamera(Scene& scene, const std::vector<Point>& positions) {
+    Point lo = positions.front(), hi = positions.front();
+    for (const auto& p : positions) {
+        for (size_t i = 0; i < 3; ++i) {
+            lo[i] = std::min(lo[i], p[i]);
+            hi[i] = std::max(hi[i], p[i]);
+        }
+    }
+
+    const floating angle = 45.0;
+    const size_t   resx = 800, resy = 600;
+    const auto     center = lo + 0.5 * (hi - lo);
+    const auto     radius = std::max(0.5 * (hi - lo).length(), epsilon);
+    const auto     distance = radius / sin(angle * M_PI / 360.0);
+    Camera::Parameters view;
+    view.from = center + Vector{0, 0, distance};
+    view.at = center;
+    view.up = Vector{0, 1, 0};
+    view.fov = angle;
+    view.hither = distance * 0.001;
+    view.width = resx;
+    view.height = resy;
+    scene.camera().setup(view);
+}
+
+} /* namespace anonymous */
+
+SceneReader::Status OBJSceneReader::init(Scene& scene,
+                                         std::string& error) const {
+    const MappedFile file{fname()};
+    if (!file.isOpen()) {
+        error = "can not read " + fname();
+        return SceneReader::E_OTHER;
+    }
+
+    auto chunks = splitChunks(file.begin(), file.end());
+    parallelFor(chunks.size(), [&](size_t i) {
+        OBJParser{file.begin(), chunks[i], true}.parse();
+    });
+
+    // Vertex offsets, material libraries and materials in use are resolved
+    // in file order.
+    ObjMaterials materials;
+    const auto   defaultMaterial = ObjMaterial{
+        scene.materials().registerMaterial(Material{Colour{0.8, 0.8, 0.8}}),
+        -1, Colour{0, 0, 0}};
+    std::vector<std::string> libraries;
+    ObjVertices              vertices;
+    size_t                   positions = 0, uvs = 0, normals = 0;
+    std::string              material;
+    for (auto& chunk : chunks) {
+        chunk.positions = positions;
+        chunk.uvs = uvs;
+        chunk.normals = normals;
+        chunk.material = material;
+        positions += chunk.positionCount;
+        uvs += chunk.uvCount;
+        normals += chunk.normalCount;
+        if (!chunk.lastMaterial.empty())
+            material = chunk.lastMaterial;
+
+        for (const auto& library : chunk.libraries) {
+            if (std::find(libraries.begin(), libraries.end(), library) !=
+                libraries.end())
+                continue;
+
+            libraries.push_back(library);
+            const auto      path = directory(fname()) + library;
+            scene.addDependency(path);
+            const MappedFile mtl{path};
+            if (!mtl.isOpen()) {
+                fprintf(stderr, "Failed to open \"%s\"\n", path.c_str());
+                continue;
+            }
+
+            MTLParser parser{scene, mtl, directory(path), materials};
+            parser.parse();
+            if (!parser.errorMessage().empty()) {
+                error = library + ": " + parser.errorMessage();
+                return SceneReader::E_PARSE;
+            }
+        }
+    }
+
+    if (positions == 0) {
+        error = "OBJ file has no vertices";
+        return SceneReader::E_PARSE;
+    }
+
+    vertices.positions.resize(positions);
+    vertices.uvs.resize(uvs);
+    vertices.normals.resize(normals);
+
+    parallelFor(chunks.size(), [&](size_t i) {
+        OBJParser{file.begin(), chunks[i], false,
+                  &vertices,    &materials, &defaultMaterial}
+            .parse();
+    });
+
+    if (!checkChunks(chunks, error))
+        return SceneReader::E_PARSE;
+
+    setupCamera(scene, vertices.positions);
+
+    // Vertex data of the file is stored once: either the shared mesh takes
+    // it over, or it is released as soon as the meshes of the chunks have
+    // copied it.
+    auto shared = shareVertices(chunks, vertices);
+    parallelFor(chunks.size(), [&](size_t i) {
+        buildChunk(scene, vertices, shared.get(), chunks[i]);
+    });
+    vertices = ObjVertices{};
+
+    if (!checkChunks(chunks, error))
+        return SceneReader::E_PARSE;
+
+    size_t total = 0;
+    for (const auto& chunk : chunks)
+        total += chunk.prims.size();
+
+    scene.reservePrimitives(total);
+    if (shared)
+        scene.addMesh(shared.release());
+    for (auto& chunk : chunks) {
+        for (auto& mesh : chunk.meshes) {
+            if (mesh)
+                scene.addMesh(mesh.release());
+        }
+        for (auto prim : chunk.prims)
+            scene.addPrimitive(prim);
+        for (auto light : chunk.lights)
+            scene.addLight(light);
+    }
+
+    if (scene.lights().empty()) {
+        const auto white = Colour{1, 1, 1};
+        Light*     light = new BackgroundLight{scene.sceneSphere(), white};
+        scene.setBackground(white);
+        scene.addLight(light);
+        scene.setBackgroundLight(light);
+    }
+
+    return SceneReader::OK;
+}
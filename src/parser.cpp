@@ -2,488 +2,854 @@
 #include "background_light.h"
 #include "common.h"
 #include "directional_light.h"
+#include "environment_light.h"
 #include "geometry.h"
+#include "instance.h"
+#include "mapped_file.h"
 #include "material.h"
+#include "parser.h"
+#include "pfm_reader.h"
 #include "point_light.h"
 #include "scene.h"
 #include "sphere.h"
 #include "spotlight.h"
 #include "texture.h"
 #include "tga_reader.h"
-#include "triangle.h"
+#include "thread_pool.h"
+#include "tokenizer.h"
+#include "triangle_light.h"
+#include "triangle_mesh.h"
 
+#include <algorithm>
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace /* anonymous */ {
 
-material_index_t current_material;
-texture_index_t  current_texture = -1;
-
-typedef double COORD3[3];
-#define SET_COORD3(r, A, B, C)                                                 \
-    {                                                                          \
-        (r)[0] = (A);                                                          \
-        (r)[1] = (B);                                                          \
-        (r)[2] = (C);                                                          \
+using Objects = std::unordered_map<std::string, Prototype*>;
+
+/**
+ * Part of the NFF file that is parsed independently of the others. Chunks
+ * start at primitive statements. Everything that changes the registries of
+ * the scene (materials, textures, camera, objects) is executed by a
+ * sequential prescan, which records the parser state at the start of the
+ * chunk and the results of the registering statements in it.
+ */
+struct Chunk {
+    const char*      begin;
+    const char*      end;
+    material_index_t material;
+    texture_index_t  texture;
+    Colour           emission;
+    Prototype*       object; ///< Object being defined at the start.
+
+    std::vector<material_index_t> materials; ///< Result of every "f".
+    std::vector<texture_index_t>  textures;  ///< Result of every "t" and "be".
+    std::vector<Prototype*>       objects;   ///< Result of every "ob" and "oi".
+
+    std::vector<std::pair<Instance*, Animation::InstanceKey>> instanceKeys;
+
+    std::vector<const Primitive*> prims;
+    std::vector<Light*>           lights;
+    Light*                        backgroundLight;
+
+    /// Polygons of the chunk, indexed by having normals plus twice by having
+    /// uv-coordinates.
+    std::unique_ptr<TriangleMesh> meshes[4];
+
+    std::string error; ///< First error of the chunk, parsing stops at it.
+};
+
+/**
+ * Parses a chunk of NFF from memory mapped file. The parser keeps the current
+ * material, texture and emission as state and reuses its vertex buffers
+ * between polygons. In prescan mode only the registering statements are
+ * executed and the rest are skipped line by line, otherwise primitives and
+ * lights are collected to the chunk.
+ *
+ * Object definitions ("ob" ... "oe") are registering statements as a whole:
+ * the prescan collects their primitives to the prototype and builds its
+ * kd-tree, the parallel parse skips them.
+ *
+ * Parsing stops at the first error, which is recorded to the chunk.
+ */
+class NFFParser {
+public: /* Methods: */
+
+    NFFParser(Scene& scene, const char* origin, Chunk& chunk, Objects& objects,
+              bool prescan)
+        : m_scene(scene)
+        , m_chunk(chunk)
+        , m_objects(objects)
+        , m_tok{chunk.begin, chunk.end, origin}
+        , m_prescan{prescan}
+        , m_material{chunk.material}
+        , m_texture{chunk.texture}
+        , m_emission{chunk.emission}
+        , m_object{chunk.object}
+        , m_nextMaterial{0}
+        , m_nextTexture{0}
+        , m_nextObject{0}
+        , m_instance{nullptr}
+    {}
+
+    material_index_t material() const { return m_material; }
+    texture_index_t texture() const { return m_texture; }
+    Colour emission() const { return m_emission; }
+    Prototype* object() const { return m_object; }
+
+    void parse() {
+        while (m_chunk.error.empty() && !m_tok.atEnd()) {
+            const auto cmd = m_tok.word();
+            if (*cmd.begin == '#') {
+                m_tok.skipLine();
+                continue;
+            }
+
+            // Keyframes of an instance follow it directly.
+            if (cmd != "ok")
+                m_instance = nullptr;
+
+            if (cmd == "v")
+                doView();
+            else if (cmd == "vk")
+                doViewKey();
+            else if (cmd == "l")
+                doRegularLight();
+            else if (cmd == "ls")
+                doSphereLight();
+            else if (cmd == "la")
+                doAreaLight();
+            else if (cmd == "lf")
+                doSpotlight();
+            else if (cmd == "ld")
+                doDirectionalLight();
+            else if (cmd == "le")
+                doEmission();
+            else if (cmd == "b")
+                doBackground();
+            else if (cmd == "be")
+                doEnvironment();
+            else if (cmd == "f")
+                doFill();
+            else if (cmd == "c")
+                doCone();
+            else if (cmd == "s")
+                doSphere(false);
+            else if (cmd == "st")
+                doSphere(true);
+            else if (cmd == "p")
+                doPoly(false, false);
+            else if (cmd == "pp")
+                doPoly(true, false);
+            else if (cmd == "pt")
+                doPoly(false, true);
+            else if (cmd == "ppt")
+                doPoly(true, true);
+            else if (cmd == "t")
+                doTexture();
+            else if (cmd == "ob")
+                doObjectBegin();
+            else if (cmd == "oe")
+                doObjectEnd();
+            else if (cmd == "oi")
+                doObjectInstance();
+            else if (cmd == "ok")
+                doObjectKey();
+            else
+                error("unknown NFF primitive code: " + cmd.str());
+        }
     }
 
-typedef double COORD2[2];
-#define SET_COORD2(r, A, B)                                                    \
-    {                                                                          \
-        (r)[0] = (A);                                                          \
-        (r)[1] = (B);                                                          \
+private: /* Methods: */
+
+    // Primitives and lights span any number of lines that start with a
+    // number. The next statement starts on a line with a letter.
+    void skipStatement() {
+        do {
+            m_tok.skipLine();
+        } while (!m_tok.atEnd() && !isalpha(m_tok.peek()) &&
+                 m_tok.peek() != '#');
     }
 
-void show_error(const char* s) { fprintf(stderr, "%s\n", s); }
+    // Primitives of objects are created by the prescan, the rest by the
+    // parallel parse.
+    bool skipping() const { return m_prescan != (m_object != nullptr); }
 
-void do_comment(FILE* fp) {
-    char* cp;
-    char  comment[256];
+    void addPrimitive(const Primitive* prim) {
+        if (m_object != nullptr)
+            m_object->addPrimitive(prim);
+        else
+            m_chunk.prims.push_back(prim);
+    }
 
-    if (fgets(comment, 255, fp) == NULL) {
-        return;
+    void addLight(Light* light) {
+        if (m_object != nullptr)
+            error("light sources can not be part of an object");
+        m_chunk.lights.push_back(light);
     }
 
-    /* strip out newline */
-    cp = (char*)strchr(comment, '\n');
-    if (cp != NULL)
-        *cp = '\0';
-}
+    void error(const std::string& msg) {
+        if (m_chunk.error.empty())
+            m_chunk.error =
+                msg + " (line " + std::to_string(m_tok.line()) + ")";
+    }
 
-void do_view(Scene& scene, FILE* fp) {
-    float x = 0, y = 0, z = 0;
-    float fov_angle = 45.0;
-    float hither = 0.001;
-    int   resx = 800;
-    int   resy = 600;
+    /// Reads @a n required and @a m optional numbers.
+    bool numbers(floating* out, size_t n, size_t m, const char* msg) {
+        if (!m_tok.numbers(out, n)) {
+            error(msg);
+            return false;
+        }
 
-    bool err = false;
+        m_tok.numbers(out + n, m);
+        return true;
+    }
 
-    err = err || (fscanf(fp, " from %f %f %f", &x, &y, &z) != 3);
-    const auto from = Point{x, y, z};
+    Point point(const floating* p) { return Point{p[0], p[1], p[2]}; }
 
-    err = err || (fscanf(fp, " at %f %f %f", &x, &y, &z) != 3);
-    const auto at = Point{x, y, z};
+    Vector vector(const floating* p) { return Vector{p[0], p[1], p[2]}; }
 
-    err = err || (fscanf(fp, " up %f %f %f", &x, &y, &z) != 3);
-    const auto up = Vector{x, y, z};
+    Colour colour(const floating* p) { return Colour{p[0], p[1], p[2]}; }
 
-    err = err || (fscanf(fp, " angle %f", &fov_angle) != 1);
+    // Files referenced from the scene are relative to the NFF file.
+    std::string relativePath(const Token& name) const {
+        std::string file_location = m_scene.getFname();
+        file_location.erase(file_location.find_last_of('/') + 1,
+                            std::string::npos);
+        return file_location + name.str();
+    }
 
-    fscanf(fp, " hither %f", &hither);
+    void doView() {
+        Camera::Parameters view;
+        if (!readView(m_tok, view))
+            return error("NFF view syntax error");
 
-    fscanf(fp, " resolution %d %d", &resx, &resy);
+        if (!m_prescan)
+            return;
 
-    if (!err) {
-        scene.camera().setup(from, at, up, fov_angle, hither, resx, resy);
-        for (auto& surface : scene.surfaces()) {
-            surface->setDimensions(resy, resx);
-        }
-    } else {
-        show_error("NFF view syntax error");
-        exit(1);
+        m_scene.camera().setup(view);
     }
-}
 
-void do_regular_light(Scene& scene, FILE* fp) {
-    float x, y, z, r = 1.0, g = 1.0, b = 1.0;
-
-    const auto n = fscanf(fp, "%f %f %f %f %f %f", &x, &y, &z, &r, &g, &b);
-    if (n != 3 && n != 6) {
-        show_error("Light source syntax error");
-        exit(1);
+    // Camera keyframe "vk frame from .. at .. up .. angle .." of an animation,
+    // the rest of the view is kept.
+    void doViewKey() {
+        floating time, from[3], at[3], up[3], angle;
+
+        bool err = !m_tok.number(time);
+        err = err || !m_tok.accept("from") || !m_tok.numbers(from, 3);
+        err = err || !m_tok.accept("at") || !m_tok.numbers(at, 3);
+        err = err || !m_tok.accept("up") || !m_tok.numbers(up, 3);
+        err = err || !m_tok.accept("angle") || !m_tok.number(angle);
+        if (err)
+            return error("NFF view keyframe syntax error");
+
+        if (m_prescan) {
+            m_scene.animation().addCameraKey(Animation::CameraKey{
+                time, point(from), point(at), vector(up), angle});
+        }
     }
 
-    const auto intensity = Colour{r, g, b};
-    const auto pos = Point{x, y, z};
+    void doRegularLight() {
+        if (skipping())
+            return skipStatement();
 
-    Light* light = new PointLight{scene.sceneSphere(), intensity, pos};
-    scene.addLight(light);
-}
+        floating v[6] = {0, 0, 0, 1, 1, 1};
+        if (!numbers(v, 3, 3, "Light source syntax error"))
+            return;
 
-void do_sphere_light(Scene& scene, FILE* fp) {
-    float R, x, y, z, r = 1.0, g = 1.0, b = 1.0;
+        Light* light =
+            new PointLight{m_scene.sceneSphere(), colour(v + 3), point(v)};
+        addLight(light);
+    }
 
-    const auto n =
-        fscanf(fp, "%f %f %f %f %f %f %f", &R, &x, &y, &z, &r, &g, &b);
-    if (n != 4 && n != 7) {
-        show_error("Spherical area light source syntax error");
-        exit(1);
+    void doSphereLight() {
+        if (skipping())
+            return skipStatement();
+
+        floating v[7] = {0, 0, 0, 0, 1, 1, 1};
+        if (!numbers(v, 4, 3, "Spherical area light source syntax error"))
+            return;
+
+        const auto intensity = colour(v + 4);
+        const auto pos = point(v + 1);
+        const auto rad = v[0];
+
+        Light* light =
+            new SphereLight{m_scene.sceneSphere(), intensity, pos, rad};
+        Primitive* prim = new Sphere{pos, rad};
+        prim->setMaterial(Materials::lightMaterial());
+        prim->setLight(light);
+        addPrimitive(prim);
+        addLight(light);
     }
 
-    const auto     intensity = Colour{r, g, b};
-    const auto     pos = Point{x, y, z};
-    const floating rad = R;
+    void doAreaLight() {
+        if (skipping())
+            return skipStatement();
+
+        floating v[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1};
+        if (!numbers(v, 9, 3, "Rectangular area light source syntax error"))
+            return;
+
+        const auto intensity = colour(v + 9);
+        const auto pos = point(v);
+        const auto u = vector(v + 3);
+        const auto w = vector(v + 6);
+
+        Light* light =
+            new AreaLight{m_scene.sceneSphere(), intensity, pos, u, w};
+        Primitive* prim = new Rectangle{pos, u, w};
+        prim->setMaterial(Materials::lightMaterial());
+        prim->setLight(light);
+        addPrimitive(prim);
+        addLight(light);
+    }
 
-    Light* light = new SphereLight{scene.sceneSphere(), intensity, pos, rad};
-    Primitive* prim = new Sphere{pos, rad};
-    prim->setMaterial(Materials::lightMaterial());
-    prim->setLight(light);
-    scene.addPrimitive(prim);
-    scene.addLight(light);
-}
+    void doDirectionalLight() {
+        if (skipping())
+            return skipStatement();
 
-void do_area_light(Scene& scene, FILE* fp) {
-    float x, y, z, ux, uy, uz, vx, vy, vz, r = 1.0, g = 1.0, b = 1.0;
+        floating v[6] = {0, 0, 0, 1, 1, 1};
+        if (!numbers(v, 3, 3, "Directional light source syntax error"))
+            return;
+
+        Light* light = new DirectionalLight{m_scene.sceneSphere(),
+                                            colour(v + 3), vector(v)};
+        addLight(light);
+    }
 
-    const auto n = fscanf(fp, "%f %f %f %f %f %f %f %f %f %f %f %f", &x, &y, &z,
-                          &ux, &uy, &uz, &vx, &vy, &vz, &r, &g, &b);
-    if (n != 9 && n != 12) {
-        show_error("Rectangular area light source syntax error");
-        exit(1);
+    // since 's' is taken let's use 'f' for flashlight as an alternative name
+    // for spotlight
+    void doSpotlight() {
+        if (skipping())
+            return skipStatement();
+
+        floating v[10] = {0, 0, 0, 0, 0, 0, 0, 1, 1, 1};
+        if (!numbers(v, 7, 3, "Spotlight source syntax error"))
+            return;
+
+        const floating alpha = v[6] * M_PI / 180.0;
+        Light* light = new Spotlight{m_scene.sceneSphere(), colour(v + 7),
+                                     point(v), vector(v + 3), alpha};
+        addLight(light);
     }
 
-    const auto intensity = Colour{r, g, b};
-    const auto pos = Point{x, y, z};
-    const auto u = Vector{ux, uy, uz};
-    const auto v = Vector{vx, vy, vz};
+    // Polygons that follow are emissive with the given radiance. Emission is
+    // turned off again with "le 0 0 0".
+    void doEmission() {
+        floating v[3];
+        if (!numbers(v, 3, 0, "Emission syntax error"))
+            return;
+        m_emission = colour(v);
+    }
 
-    Light*     light = new AreaLight{scene.sceneSphere(), intensity, pos, u, v};
-    Primitive* prim = new Rectangle{pos, u, v};
-    prim->setMaterial(Materials::lightMaterial());
-    prim->setLight(light);
-    scene.addPrimitive(prim);
-    scene.addLight(light);
-}
+    void doBackground() {
+        floating v[3];
+        if (!numbers(v, 3, 0, "background color syntax error"))
+            return;
 
-void do_directional_light(Scene& scene, FILE* fp) {
-    float x, y, z, r = 1.0, g = 1.0, b = 1.0;
+        const auto col = colour(v);
+        if (m_prescan) {
+            m_scene.setBackground(col);
+            return;
+        }
 
-    const auto n = fscanf(fp, "%f %f %f %f %f %f", &x, &y, &z, &r, &g, &b);
-    if (n != 6 && n != 3) {
-        show_error("Directional light source syntax error");
-        exit(1);
+        if (v[0] > 0 || v[1] > 0 || v[2] > 0) {
+            Light* light = new BackgroundLight{m_scene.sceneSphere(), col};
+            addLight(light);
+            m_chunk.backgroundLight = light;
+        }
     }
 
-    const auto intensity = Colour{r, g, b};
-    const auto dir = Vector{x, y, z};
-    Light* light = new DirectionalLight{scene.sceneSphere(), intensity, dir};
-    scene.addLight(light);
-}
+    // Equirectangular environment map in TGA or PFM format with optional
+    // scale.
+    void doEnvironment() {
+        const auto name = m_tok.word();
+        if (name.empty())
+            return error("Environment map syntax error");
+
+        floating scale = 1.0;
+        m_tok.number(scale);
+
+        if (m_prescan) {
+            const auto map_file = relativePath(name);
+            m_scene.addDependency(map_file);
+            const auto is_pfm =
+                map_file.size() >= 4 &&
+                map_file.compare(map_file.size() - 4, 4, ".pfm") == 0;
+            auto texture = is_pfm ? readPfm(map_file) : readTexture(map_file);
+            if (texture.width() == 0)
+                return error("environment map " + name.str() +
+                             " can not be read");
+            m_chunk.textures.push_back(
+                m_scene.textures().registerTexture(std::move(texture)));
+            return;
+        }
 
-void do_spotlight(Scene& scene, FILE* fp) {
-    float x, y, z, dx, dy, dz, a, r = 1.0, g = 1.0, b = 1.0;
+        const auto index = m_chunk.textures[m_nextTexture++];
+        Light* light = new EnvironmentLight{m_scene.sceneSphere(),
+                                            m_scene.textures(), index, scale};
+        addLight(light);
+        m_chunk.backgroundLight = light;
+    }
+
+    void doFill() {
+        floating v[8];
+        if (!numbers(v, 3, 0, "fill color syntax error") ||
+            !numbers(v + 3, 5, 0, "fill material syntax error"))
+            return;
+
+        const auto kd = v[3], ks = v[4], t = v[6], ior = v[7];
+        // Phong power below 1 can not be converted to highlight angle.
+        const auto phong_pow = std::max(v[5], 1.0);
+        if (m_prescan) {
+            m_material = m_scene.materials().registerMaterial(
+                Material(colour(v), kd, ks, t, ior, phong_pow));
+            m_chunk.materials.push_back(m_material);
+            return;
+        }
 
-    const auto n = fscanf(fp, "%f %f %f %f %f %f %f %f %f %f", &x, &y, &z, &dx,
-                          &dy, &dz, &a, &r, &g, &b);
-    if (n != 10 && n != 7) {
-        show_error("Spotlight source syntax error");
-        exit(1);
+        m_material = m_chunk.materials[m_nextMaterial++];
     }
 
-    const auto     intensity = Colour{r, g, b};
-    const auto     pos = Point{x, y, z};
-    const auto     dir = Vector{dx, dy, dz};
-    const floating alpha = a * M_PI / 180.0;
+    // TODO: support for cones
+    void doCone() {
+        if (skipping())
+            return skipStatement();
 
-    Light* light =
-        new Spotlight{scene.sceneSphere(), intensity, pos, dir, alpha};
-    scene.addLight(light);
-}
+        floating v[8];
+        if (numbers(v, 8, 0, "cylinder or cone syntax error"))
+            error("No support for cones or cylinder.");
+    }
 
-void do_light(Scene& scene, FILE* fp) {
+    void doSphere(bool textured) {
+        if (skipping())
+            return skipStatement();
 
-    const auto c = getc(fp);
+        floating v[4];
+        if (!numbers(v, 4, 0, "sphere syntax error"))
+            return;
 
-    if (c == 's') {
-        do_sphere_light(scene, fp);
-        return;
+        Primitive* p = new Sphere(point(v), v[3]);
+        p->setMaterial(m_material);
+        if (textured)
+            p->setTexture(m_texture);
+        addPrimitive(p);
     }
 
-    if (c == 'a') {
-        do_area_light(scene, fp);
-        return;
-    }
+    void doPoly(bool ispatch, bool textured) {
+        if (skipping())
+            return skipStatement();
+
+        int nverts;
+        if (!m_tok.number(nverts) || nverts < 0)
+            return error("polygon or patch syntax error");
+
+        m_verts.resize(nverts);
+        m_norms.resize(ispatch ? nverts : 0);
+        m_uvs.resize(textured ? nverts : 0);
+
+        /* read all the vertices into temp array */
+        for (int i = 0; i < nverts; ++i) {
+            floating v[3];
+            if (!m_tok.numbers(v, 3))
+                return error("polygon or patch syntax error");
+            m_verts[i] = point(v);
+
+            if (ispatch) {
+                if (!m_tok.numbers(v, 3))
+                    return error("polygon or patch syntax error");
+                m_norms[i] = vector(v);
+            }
+
+            if (textured) {
+                if (!m_tok.numbers(v, 2))
+                    return error("polygon or patch syntax error");
+                m_uvs[i] = Vector2{v[0], v[1]};
+            }
+        }
 
-    // since 's' is taken let's use 'f' for flashlight as an alternative name
-    // for spotlight
-    if (c == 'f') {
-        do_spotlight(scene, fp);
-        return;
+        auto& mesh = chunkMesh(ispatch, textured);
+        m_indices.resize(nverts);
+        for (int i = 0; i < nverts; ++i) {
+            const auto normal = ispatch ? m_norms[i] : Vector{0, 0, 0};
+            const auto uv = textured ? m_uvs[i] : Vector2{0, 0};
+            m_indices[i] = mesh.addVertex(m_verts[i], normal, uv);
+        }
+
+        /* XXX Naíve */
+        for (int i = 1; i < nverts - 1; ++i) {
+            addTriangle(mesh, 0, i, i + 1, textured);
+        }
     }
 
-    if (c == 'd') {
-        do_directional_light(scene, fp);
-        return;
+    TriangleMesh& chunkMesh(bool ispatch, bool textured) {
+        auto& mesh = m_chunk.meshes[ispatch + 2 * textured];
+        if (!mesh)
+            mesh.reset(new TriangleMesh{ispatch, textured});
+        return *mesh;
     }
 
-    ungetc(c, fp);
-    do_regular_light(scene, fp);
-}
+    void addTriangle(TriangleMesh& mesh, size_t p0, size_t p1, size_t p2,
+                     bool textured) {
+        // Degenerate emitters can not be hit either.
+        const auto emissive = luminance(m_emission) > 0.0;
+        if (emissive &&
+            !TriangleLight::hasArea(m_verts[p0], m_verts[p1], m_verts[p2]))
+            return;
+
+        if (emissive && m_object != nullptr)
+            return error("emissive polygons can not be part of an object");
+        if (!emissive && textured && m_texture < 0)
+            return error("texture must be defined before trying to use one");
+
+        Primitive* p = new MeshTriangle{mesh, m_indices[p0], m_indices[p1],
+                                        m_indices[p2]};
+
+        if (emissive) {
+            Light* light = new TriangleLight{m_scene.sceneSphere(), m_emission,
+                                             m_verts[p0], m_verts[p1],
+                                             m_verts[p2]};
+            p->setMaterial(Materials::lightMaterial());
+            p->setLight(light);
+            addPrimitive(p);
+            addLight(light);
+            return;
+        }
 
-void do_background(Scene& scene, FILE* fp) {
-    float r = 0, g = 0, b = 0;
-    if (fscanf(fp, "%f %f %f", &r, &g, &b) != 3) {
-        show_error("background color syntax error");
-        exit(1);
-    }
+        p->setMaterial(m_material);
+        if (textured)
+            p->setTexture(m_texture);
 
-    const auto col = Colour{r, g, b};
-    scene.setBackground(col);
-    if (r > 0 || g > 0 || b > 0) {
-        Light* light = new BackgroundLight{scene.sceneSphere(), col};
-        scene.addLight(light);
-        scene.setBackgroundLight(light);
+        addPrimitive(p);
     }
-}
 
-void do_fill(Scene& scene, FILE* fp) {
-    float r, g, b, kd, ks, ks_spec, phong_pow, ang, t, ior;
+    void doTexture() {
+        const auto name = m_tok.word();
+        if (name.empty())
+            return error("texture syntax error");
+
+        if (m_prescan) {
+            const auto map_file = relativePath(name);
+            m_scene.addDependency(map_file);
+            auto texture = readTexture(map_file);
+            if (texture.width() == 0)
+                return error("texture " + name.str() + " can not be read");
+            m_texture = m_scene.textures().registerTexture(std::move(texture));
+            m_chunk.textures.push_back(m_texture);
+            return;
+        }
 
-    if (fscanf(fp, "%f %f %f", &r, &g, &b) != 3) {
-        show_error("fill color syntax error");
-        exit(1);
+        m_texture = m_chunk.textures[m_nextTexture++];
     }
 
-    if (fscanf(fp, "%f %f %f %f %f", &kd, &ks, &phong_pow, &t, &ior) != 5) {
-        show_error("fill material syntax error");
-        exit(1);
+    // Object definition "ob name" is followed by the primitives of the object
+    // and ends with "oe". Objects are only placed in the scene by instances.
+    void doObjectBegin() {
+        const auto name = m_tok.word();
+        if (name.empty())
+            return error("object definition syntax error");
+        if (m_object != nullptr)
+            return error("object definitions can not be nested");
+
+        if (!m_prescan) {
+            m_object = m_chunk.objects[m_nextObject++];
+            return;
+        }
+
+        m_object = new Prototype{};
+        m_scene.addPrototype(m_object);
+        if (!m_objects.emplace(name.str(), m_object).second)
+            return error("object " + name.str() + " is already defined");
+        m_chunk.objects.push_back(m_object);
     }
 
-    ks_spec = ks;
-    /* convert phong_pow back into phong hilight angle. */
-    /* reciprocal of formula in libpr1.c, lib_output_color() */
-    if (phong_pow < 1.0)
-        phong_pow = 1.0;
-    ang = (float)((180.0 / M_PI) * acos(exp(log(0.5) / phong_pow)));
+    void doObjectEnd() {
+        if (m_object == nullptr)
+            return error("object definition end without a beginning");
 
-    current_material = scene.materials().registerMaterial(
-        Material(Colour(r, g, b), kd, ks, t, ior, phong_pow));
-}
-
-// TODO: support for cones
-void do_cone(Scene&, FILE* fp) {
-    float x0, y0, z0, x1, y1, z1, r0, r1;
+        if (m_prescan) {
+            if (m_object->empty())
+                return error("object definition has no primitives");
+            m_object->init();
+        }
 
-    if (fscanf(fp, " %f %f %f %f %f %f %f %f", &x0, &y0, &z0, &r0, &x1, &y1,
-               &z1, &r1) != 8) {
-        show_error("cylinder or cone syntax error");
-        exit(1);
-    }
-    if (r0 < 0.0) {
-        r0 = -r0;
-        r1 = -r1;
+        m_object = nullptr;
     }
 
-    show_error("No support for cones or cylinder.");
-    exit(1);
-}
+    // Instance "oi name [fill] m00 m01 m02 m03 m10 ... m23" places the object
+    // by the rows of an affine transformation. With "fill" the primitives of
+    // the object take the current material instead of their own.
+    void doObjectInstance() {
+        const auto name = m_tok.word();
+        if (name.empty())
+            return error("object instance syntax error");
+
+        const bool fill = m_tok.accept("fill");
+        Matrix     toWorld;
+        if (!transformation(toWorld, "object instance syntax error"))
+            return;
+        if (m_object != nullptr)
+            return error("object instances can not be part of an object");
+
+        if (m_prescan) {
+            const auto it = m_objects.find(name.str());
+            if (it == m_objects.end())
+                return error("object " + name.str() + " is not defined");
+            m_chunk.objects.push_back(it->second);
+            return;
+        }
 
-void do_sphere(Scene& scene, FILE* fp) {
-    float x, y, z, r;
-    int   textured;
+        auto instance =
+            new Instance{*m_chunk.objects[m_nextObject++], toWorld, fill};
+        instance->setMaterial(m_material);
+        addPrimitive(instance);
+        m_instance = instance;
+    }
 
-    textured = getc(fp);
-    if (textured != 't') {
-        ungetc(textured, fp);
-        textured = 0;
+    // Keyframe "ok frame m00 m01 m02 m03 m10 ... m23" of the transformation
+    // of the instance before it.
+    void doObjectKey() {
+        floating time;
+        if (!m_tok.number(time))
+            return error("object keyframe syntax error");
+
+        Matrix toWorld;
+        if (!transformation(toWorld, "object keyframe syntax error") ||
+            m_prescan)
+            return;
+
+        if (m_instance == nullptr)
+            return error("object keyframe must follow an object instance");
+        m_chunk.instanceKeys.emplace_back(
+            m_instance, Animation::InstanceKey{time, toWorld});
     }
 
-    if (fscanf(fp, "%f %f %f %f", &x, &y, &z, &r) != 4) {
-        show_error("sphere syntax error");
-        exit(1);
+    /// Reads the rows of an affine transformation.
+    bool transformation(Matrix& out, const char* msg) {
+        floating m[12];
+        if (!numbers(m, 12, 0, msg))
+            return false;
+
+        const auto det = m[0] * (m[5] * m[10] - m[6] * m[9]) -
+                         m[1] * (m[4] * m[10] - m[6] * m[8]) +
+                         m[2] * (m[4] * m[9] - m[5] * m[8]);
+        if (almost_zero(det)) {
+            error("transformation is singular");
+            return false;
+        }
+
+        out = Matrix{m[0], m[1], m[2],  m[3],
+                     m[4], m[5], m[6],  m[7],
+                     m[8], m[9], m[10], m[11],
+                     0,    0,    0,     1};
+        return true;
     }
 
-    Primitive* p = new Sphere(Point(x, y, z), r);
-    p->setMaterial(current_material);
-    if (textured)
-        p->setTexture(current_texture);
-    scene.addPrimitive(p);
+private: /* Fields: */
+    Scene&                m_scene;
+    Chunk&                m_chunk;
+    Objects&              m_objects; ///< Objects defined so far by name.
+    Tokenizer             m_tok;
+    const bool            m_prescan;
+    material_index_t      m_material;
+    texture_index_t       m_texture;
+    Colour                m_emission;
+    Prototype*            m_object; ///< Object being defined, if any.
+    size_t                m_nextMaterial;
+    size_t                m_nextTexture;
+    size_t                m_nextObject;
+    Instance*             m_instance; ///< Instance keyframes refer to.
+    std::vector<Point>    m_verts;
+    std::vector<Vector>   m_norms;
+    std::vector<Vector2>  m_uvs;
+    std::vector<uint32_t> m_indices;
+};
+
+/// Chunk boundaries are placed at lines that start a primitive.
+bool isPrimitiveLine(const char* p, const char* end) {
+    if (p == end || (*p != 'p' && *p != 's'))
+        return false;
+
+    for (++p; p != end && (*p == 'p' || *p == 't'); ++p)
+        ;
+    return p == end || *p == ' ' || *p == '\t';
 }
 
-void do_poly(Scene& scene, FILE* fp) {
-    int     ispatch;
-    int     textured;
-    int     nverts;
-    int     vertcount;
-    COORD3* norms;
-    COORD3* verts;
-    COORD2* uvs;
-    float   x, y, z;
+std::vector<Chunk> splitChunks(const char* begin, const char* end) {
+    const size_t size = end - begin;
+    const size_t count = std::max(size / RAY_PARSE_CHUNK_SIZE, size_t{1});
+
+    std::vector<Chunk> chunks;
+    auto               start = begin;
+    for (size_t i = 1; i <= count; ++i) {
+        auto p = i == count ? end : std::max(begin + i * size / count, start);
+        while (p != end && !(p[-1] == '\n' && isPrimitiveLine(p, end))) {
+            p = static_cast<const char*>(memchr(p, '\n', end - p));
+            p = p == nullptr ? end : p + 1;
+        }
 
-    norms = verts = NULL;
-    uvs = NULL;
+        if (p == start)
+            continue;
 
-    ispatch = getc(fp);
-    if (ispatch != 'p') {
-        ungetc(ispatch, fp);
-        ispatch = 0;
+        chunks.push_back(Chunk{start, p, 0, -1, Colour{0, 0, 0}, nullptr, {},
+                               {}, {}, {}, {}, {}, nullptr, {}, {}});
+        start = p;
     }
-    textured = getc(fp);
-    if (textured != 't') {
-        ungetc(textured, fp);
-        textured = 0;
+
+    return chunks;
+}
+
+/// Frees what the chunks created outside of the scene.
+void discard(std::vector<Chunk>& chunks) {
+    for (const auto& chunk : chunks) {
+        for (auto prim : chunk.prims)
+            delete prim;
+        for (auto light : chunk.lights)
+            delete light;
     }
+}
+
+} /* namespace anonymous */
 
-    if (fscanf(fp, "%d", &nverts) != 1)
-        goto fmterr;
+bool readView(Tokenizer& tok, Camera::Parameters& view) {
+    floating from[3], at[3], up[3], angle, hither = 0.001;
+    floating aperture = 0.0, focus = 0.0;
+    int      resx = 800, resy = 600;
 
-    verts = (COORD3*)malloc(nverts * sizeof(COORD3));
-    if (verts == NULL)
-        goto memerr;
+    bool err = false;
+    err = err || !tok.accept("from") || !tok.numbers(from, 3);
+    err = err || !tok.accept("at") || !tok.numbers(at, 3);
+    err = err || !tok.accept("up") || !tok.numbers(up, 3);
+    err = err || !tok.accept("angle") || !tok.number(angle);
+    err = err || (tok.accept("hither") && !tok.number(hither));
+    err = err || (tok.accept("resolution") &&
+                  !(tok.number(resx) && tok.number(resy)));
+    err = err || (tok.accept("aperture") && !tok.number(aperture));
+    err = err || (tok.accept("focus") && !tok.number(focus));
+
+    // A view that can not be rendered is a syntax error as well.
+    err = err || !(angle > 0.0 && angle < 180.0) || !(hither > 0.0);
+    err = err || resx <= 0 || resy <= 0 || aperture < 0.0 || focus < 0.0;
+    if (err)
+        return false;
 
-    if (ispatch) {
-        norms = (COORD3*)malloc(nverts * sizeof(COORD3));
-        if (norms == NULL)
-            goto memerr;
-    }
+    view.from = Point{from[0], from[1], from[2]};
+    view.at = Point{at[0], at[1], at[2]};
+    view.up = Vector{up[0], up[1], up[2]};
+    view.fov = angle;
+    view.hither = hither;
+    view.width = resx;
+    view.height = resy;
+    view.aperture = aperture;
+    view.focus = focus;
+    return true;
+}
 
-    if (textured) {
-        uvs = (COORD2*)malloc(nverts * sizeof(COORD2));
-        if (uvs == NULL)
-            goto memerr;
+bool nff2scene(Scene& scene, char const* fname, std::string& error) {
+    const MappedFile file{fname};
+    if (!file.isOpen()) {
+        error = "can not read " + std::string{fname};
+        return false;
     }
 
-    /* read all the vertices into temp array */
-    for (vertcount = 0; vertcount < nverts; vertcount++) {
-        if (fscanf(fp, " %f %f %f", &x, &y, &z) != 3)
-            goto fmterr;
-        SET_COORD3(verts[vertcount], x, y, z);
-
-        if (ispatch) {
-            if (fscanf(fp, " %f %f %f", &x, &y, &z) != 3)
-                goto fmterr;
-            SET_COORD3(norms[vertcount], x, y, z);
+    auto    chunks = splitChunks(file.begin(), file.end());
+    Objects objects;
+
+    // Sequential prescan executes the statements that register materials,
+    // textures, objects and set up the camera in file order.
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        auto parser = NFFParser{scene, file.begin(), chunks[i], objects, true};
+        parser.parse();
+        if (!chunks[i].error.empty()) {
+            error = chunks[i].error;
+            discard(chunks);
+            return false;
         }
 
-        if (textured) {
-            if (fscanf(fp, " %f %f", &x, &y) != 2)
-                goto fmterr;
-            SET_COORD2(uvs[vertcount], x, y);
+        if (i + 1 < chunks.size()) {
+            chunks[i + 1].material = parser.material();
+            chunks[i + 1].texture = parser.texture();
+            chunks[i + 1].emission = parser.emission();
+            chunks[i + 1].object = parser.object();
+        } else if (parser.object() != nullptr) {
+            error = "object definition is not terminated";
+            discard(chunks);
+            return false;
         }
     }
 
-    /* write output */
-    /*    if (ispatch)
-      lib_output_polypatch(nverts, verts, norms);
-        else
-      lib_output_polygon(nverts, verts);
-    */
-    /* XXX Naíve */
-    for (int i = 1; i < nverts - 1; ++i) {
-        Primitive* p;
-        const auto p0 = 0;
-        const auto p1 = i;
-        const auto p2 = i + 1;
-
-        const auto point0 = Point{verts[p0][0], verts[p0][1], verts[p0][2]};
-        const auto point1 = Point{verts[p1][0], verts[p1][1], verts[p1][2]};
-        const auto point2 = Point{verts[p2][0], verts[p2][1], verts[p2][2]};
-
-        if (ispatch && textured) {
-            const auto n0 = Vector{norms[p0][0], norms[p0][1], norms[p0][2]};
-            const auto n1 = Vector{norms[p1][0], norms[p1][1], norms[p1][2]};
-            const auto n2 = Vector{norms[p2][0], norms[p2][1], norms[p2][2]};
-            const auto v0 = make_vertex(point0, n0, uvs[p0][0], uvs[p0][1]);
-            const auto v1 = make_vertex(point1, n1, uvs[p1][0], uvs[p1][1]);
-            const auto v2 = make_vertex(point2, n2, uvs[p2][0], uvs[p2][1]);
-            p = make_triangle(v0, v1, v2);
-        } else if (ispatch) {
-            const auto n0 = Vector{norms[p0][0], norms[p0][1], norms[p0][2]};
-            const auto n1 = Vector{norms[p1][0], norms[p1][1], norms[p1][2]};
-            const auto n2 = Vector{norms[p2][0], norms[p2][1], norms[p2][2]};
-            const auto v0 = make_vertex(point0, n0);
-            const auto v1 = make_vertex(point1, n1);
-            const auto v2 = make_vertex(point2, n2);
-            p = make_triangle(v0, v1, v2);
-        } else if (textured) {
-            const auto v0 = make_vertex(point0, uvs[p0][0], uvs[p0][1]);
-            const auto v1 = make_vertex(point1, uvs[p1][0], uvs[p1][1]);
-            const auto v2 = make_vertex(point2, uvs[p2][0], uvs[p2][1]);
-            p = make_triangle(v0, v1, v2);
-        } else {
-            const auto v0 = make_vertex(point0);
-            const auto v1 = make_vertex(point1);
-            const auto v2 = make_vertex(point2);
-            p = make_triangle(v0, v1, v2);
+    // Chunks are parsed in parallel and merged in file order.
+    parallelFor(chunks.size(), [&](size_t i) {
+        NFFParser{scene, file.begin(), chunks[i], objects, false}.parse();
+        for (auto& mesh : chunks[i].meshes) {
+            if (mesh)
+                mesh->finish();
         }
+    });
 
-        p->setMaterial(current_material);
-        if (textured) {
-            if (current_texture < 0)
-                goto textureError;
-            p->setTexture(current_texture);
+    for (const auto& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            error = chunk.error;
+            discard(chunks);
+            return false;
         }
-
-        scene.addPrimitive(p);
-    }
-
-    free(verts);
-    if (ispatch)
-        free(norms);
-    if (textured)
-        free(uvs);
-
-    return;
-fmterr:
-    show_error("polygon or patch syntax error");
-    exit(1);
-memerr:
-    show_error("can't allocate memory for polygon or patch");
-    exit(1);
-textureError:
-    show_error("texture must be defined before trying to use one");
-    exit(1);
-}
-
-void do_texture(Scene& scene, FILE* fp) {
-    char tf[511];
-
-    if (fscanf(fp, " %s", tf) != 1) {
-        show_error("texture syntax error");
-        exit(1);
     }
-    // assume texture file is in the same location as the nff file that
-    // references it
-    std::string file_location = scene.getFname();
-    file_location.erase(scene.getFname().find_last_of('/') + 1,
-                        std::string::npos);
-    std::string texture_file = file_location + std::string(tf);
 
-    current_texture =
-        scene.textures().registerTexture(readTexture(texture_file));
-}
+    size_t total = 0;
+    for (const auto& chunk : chunks)
+        total += chunk.prims.size();
 
-void parse_nff(Scene& scene, FILE* fp) {
-    int c;
-    while ((c = getc(fp)) != EOF) {
-        switch (c) {
-        case ' ': /* white space */
-        case '\t':
-        case '\n':
-        case '\f':
-        case '\r': continue;
-        case '#': do_comment(fp); break;
-        case 'v': do_view(scene, fp); break;
-        case 'l': do_light(scene, fp); break;
-        case 'b': do_background(scene, fp); break;
-        case 'f': do_fill(scene, fp); break;
-        case 'c': do_cone(scene, fp); break;
-        case 's': do_sphere(scene, fp); break;
-        case 'p': do_poly(scene, fp); break;
-        case 't': do_texture(scene, fp); break;
-        default: /* unknown */
-            show_error("unknown NFF primitive code: ");
-            exit(1);
+    scene.reservePrimitives(total);
+    for (auto& chunk : chunks) {
+        for (auto& mesh : chunk.meshes) {
+            if (mesh)
+                scene.addMesh(mesh.release());
         }
+        for (auto prim : chunk.prims)
+            scene.addPrimitive(prim);
+        for (auto light : chunk.lights)
+            scene.addLight(light);
+        for (const auto& key : chunk.instanceKeys)
+            scene.animation().addInstanceKey(key.first, key.second);
+        if (chunk.backgroundLight != nullptr)
+            scene.setBackgroundLight(chunk.backgroundLight);
     }
-} /* parse_nff */
 
-} /* namespace anonymous */
-
-bool nff2scene(Scene& scene, char const* fname) {
-    FILE* fp;
+    return true;
+}
 
-    if ((fp = fopen(fname, "r")) == NULL) {
+bool nff2views(std::vector<Camera::Parameters>& views, char const* fname) {
+    const MappedFile file{fname};
+    if (!file.isOpen()) {
+        fprintf(stderr, "Failed to open \"%s\"\n", fname);
         return false;
     }
 
-    parse_nff(scene, fp);
+    Tokenizer tok{file.begin(), file.end(), file.begin()};
+    while (!tok.atEnd()) {
+        const auto cmd = tok.word();
+        if (*cmd.begin == '#') {
+            tok.skipLine();
+            continue;
+        }
 
-    fclose(fp);
+        Camera::Parameters view;
+        if (cmd != "v" || !readView(tok, view)) {
+            fprintf(stderr, "NFF view syntax error (line %zu)\n", tok.line());
+            return false;
+        }
+
+        views.push_back(view);
+    }
 
     return true;
 }
@@ -0,0 +1,87 @@
+#include "pfm_reader.h"
+
+#include "texture.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace /* anonymous */ {
+
+bool isLittleEndian() {
+    const uint16_t x = 1;
+    return *reinterpret_cast<const uint8_t*>(&x) == 1;
+}
+
+float swapBytes(float f) {
+    uint8_t b[4];
+    memcpy(b, &f, 4);
+    std::swap(b[0], b[3]);
+    std::swap(b[1], b[2]);
+    memcpy(&f, b, 4);
+    return f;
+}
+
+} // anonymous namespace
+
+/**
+ * Portable float map. Both RGB ("PF") and greyscale ("Pf") images are
+ * supported. Rows are stored from bottom to top just like in TGA files.
+ * A file that can not be read gives an empty texture.
+ */
+Texture readPfm(std::string pfmFileName) {
+    FILE* fptr;
+    if ((fptr = fopen(pfmFileName.c_str(), "rb")) == NULL) {
+        fprintf(stderr, "Failed to open texture file \"%s\"\n",
+                pfmFileName.c_str());
+        return Texture(0, 0);
+    }
+
+    char  magic[3] = {0};
+    int   width = 0, height = 0;
+    float scale = 0;
+    if (fscanf(fptr, "%2s %d %d %f", magic, &width, &height, &scale) != 4 ||
+        magic[0] != 'P' || (magic[1] != 'F' && magic[1] != 'f') ||
+        width <= 0 || height <= 0) {
+        fprintf(stderr, "Invalid PFM header\n");
+        fclose(fptr);
+        return Texture(0, 0);
+    }
+
+    // Exactly one whitespace character separates header from data.
+    fgetc(fptr);
+
+    const size_t channels = magic[1] == 'F' ? 3 : 1;
+    const bool   swap = (scale < 0) != isLittleEndian();
+    std::vector<float> row(width * channels);
+    Texture texels(width, height);
+
+    for (int i = 0; i < height; ++i) {
+        if (fread(row.data(), sizeof(float), row.size(), fptr) != row.size()) {
+            fprintf(stderr, "Unexpected end of file at row %d\n", i);
+            fclose(fptr);
+            return Texture(0, 0);
+        }
+
+        for (int j = 0; j < width; ++j) {
+            float c[3];
+            for (size_t k = 0; k < 3; ++k) {
+                c[k] = row[j * channels + (channels == 3 ? k : 0)];
+                if (swap)
+                    c[k] = swapBytes(c[k]);
+                if (!std::isfinite(c[k]) || c[k] < 0)
+                    c[k] = 0;
+            }
+
+            texels(j, i) = Colour{c[0], c[1], c[2]};
+        }
+    }
+
+    fclose(fptr);
+
+    return texels;
+}
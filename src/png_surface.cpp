@@ -13,15 +13,32 @@ void PngSurface::init() {
 }
 
 PngSurface::~PngSurface() {
+    write();
+    if (data == NULL)
+        return;
+
+    for (int i = 0; i < m_height; ++i) {
+        delete[] data[i];
+        data[i] = NULL;
+    }
+
+    delete[] data;
+    data = NULL;
+}
+
+void PngSurface::write() {
     gdImagePtr im;
     FILE*      out;
 
-    im = gdImageCreateTrueColor(width(), height());
+    if (data == NULL)
+        return;
+
     if (!(out = fopen(m_fname.c_str(), "wb"))) {
         std::cerr << "Unable to open/create file " << m_fname << std::endl;
         return;
     }
 
+    im = gdImageCreateTrueColor(width(), height());
     for (int h = 0; h < m_height; ++h) {
         for (int w = 0; w < m_width; ++w) {
             gdImageSetPixel(im, w, h, data[h][w]);
@@ -31,12 +48,4 @@ PngSurface::~PngSurface() {
     gdImagePng(im, out);
     fclose(out);
     gdImageDestroy(im);
-
-    for (int i = 0; i < m_height; ++i) {
-        delete[] data[i];
-        data[i] = NULL;
-    }
-
-    delete[] data;
-    data = NULL;
 }
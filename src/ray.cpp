@@ -1,14 +1,13 @@
 #include "ray.h"
 
 #include "intersection.h"
-#include "primitive.h"
 
 #include <cassert>
 
 Ray Ray::reflect(const Intersection& intr) const {
     assert(intr.getPrimitive());
     const auto P = intr.point();
-    auto       N = intr.getPrimitive()->normal(P);
+    auto       N = intr.normal();
     const auto V = m_dir;
     const auto internal = V.dot(N) < 0.0;
     if (internal) {
@@ -0,0 +1,277 @@
+#include "render_server.h"
+
+#include "float_surface.h"
+#include "kdtree_primitive_manager.h"
+#include "mapped_file.h"
+#include "nff_scene_reader.h"
+#include "obj_scene_reader.h"
+#include "parser.h"
+#include "pathtracer.h"
+#include "raytracer.h"
+#include "scene.h"
+#include "tga_surface.h"
+#include "tokenizer.h"
+#include "vcm.h"
+
+#ifdef HAVE_GD_SUPPORT_PNG
+  #include "png_surface.h"
+#endif
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace /* anonymous */ {
+
+/// Seconds a reply may wait for a client that does not read, after that the
+/// reply is dropped so that the render goes on.
+const long replyTimeout = 10;
+
+bool endsWith(const std::string& s, const char* suffix) {
+    const auto n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+/// Sends the line, a client that went away is noticed by the next read.
+void reply(int fd, const std::string& line) {
+    const auto msg = line + "\n";
+    for (size_t sent = 0; sent < msg.size();) {
+        const auto n =
+            send(fd, msg.data() + sent, msg.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return;
+        sent += n;
+    }
+}
+
+} // namespace anonymous
+
+RenderServer::RenderServer(std::string socketPath,
+                           RussianRoulette russianRoulette, bool useCache)
+    : m_socketPath{std::move(socketPath)}
+    , m_russianRoulette{russianRoulette}
+    , m_useCache{useCache}
+    , m_listener{-1}
+    , m_shutdown{false}
+{}
+
+RenderServer::~RenderServer() {}
+
+bool RenderServer::run() {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (m_socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path \"" << m_socketPath << "\" is too long."
+                  << std::endl;
+        return false;
+    }
+
+    strcpy(addr.sun_path, m_socketPath.c_str());
+    const auto listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(m_socketPath.c_str());
+    if (listener < 0 ||
+        bind(listener, (const sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(listener, 8) != 0) {
+        perror(m_socketPath.c_str());
+        if (listener >= 0)
+            close(listener);
+        return false;
+    }
+
+    std::cout << "Serving on " << m_socketPath << std::endl;
+    m_listener = listener;
+    while (!m_shutdown) {
+        const auto fd = accept(listener, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+
+        timeval timeout{replyTimeout, 0};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        boost::mutex::scoped_lock lock{m_clientMutex};
+        if (m_shutdown) {
+            close(fd);
+            break;
+        }
+
+        m_clients.insert(fd);
+        boost::thread{[this, fd]() {
+            serve(fd);
+            boost::mutex::scoped_lock lock{m_clientMutex};
+            m_clients.erase(fd);
+            close(fd);
+            m_clientGone.notify_all();
+        }}.detach();
+    }
+
+    // Clients that are still connected are cut off.
+    {
+        boost::mutex::scoped_lock lock{m_clientMutex};
+        for (auto fd : m_clients)
+            ::shutdown(fd, SHUT_RDWR);
+        while (!m_clients.empty())
+            m_clientGone.wait(lock);
+    }
+
+    close(listener);
+    unlink(m_socketPath.c_str());
+    return true;
+}
+
+void RenderServer::serve(int fd) {
+    std::string buffer;
+    char        chunk[4096];
+    while (!m_shutdown) {
+        const auto n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            return;
+
+        buffer.append(chunk, n);
+        size_t nl;
+        while (!m_shutdown && (nl = buffer.find('\n')) != std::string::npos) {
+            const auto request = buffer.substr(0, nl);
+            buffer.erase(0, nl + 1);
+            handle(fd, request);
+        }
+    }
+}
+
+void RenderServer::handle(int fd, const std::string& request) {
+    Tokenizer  tok{request.data(), request.data() + request.size()};
+    const auto cmd = tok.word();
+    if (cmd.empty())
+        return;
+
+    boost::mutex::scoped_lock lock{m_jobMutex};
+    if (m_shutdown) {
+        reply(fd, "error server is shutting down");
+        return;
+    }
+
+    if (cmd == "render") {
+        render(fd, request);
+    } else if (cmd == "unload") {
+        const auto fname = tok.word().str();
+        if (m_scenes.erase(fname) == 0)
+            reply(fd, "error scene " + fname + " is not loaded");
+        else
+            reply(fd, "done " + fname);
+    } else if (cmd == "shutdown") {
+        m_shutdown = true;
+        reply(fd, "done");
+        ::shutdown(m_listener, SHUT_RDWR); // wakes up accept
+    } else {
+        reply(fd, "error unknown request " + cmd.str());
+    }
+}
+
+void RenderServer::render(int fd, const std::string& request) {
+    Tokenizer tok{request.data(), request.data() + request.size()};
+    tok.word();
+    const auto fname = tok.word().str();
+    const auto output = tok.word().str();
+    if (output.empty()) {
+        reply(fd, "error render syntax error");
+        return;
+    }
+
+    int                samples = 1;
+    std::string        renderer = "whitted";
+    bool               hasView = false;
+    Camera::Parameters view;
+    while (!tok.atEnd()) {
+        const auto word = tok.word();
+        bool       ok = true;
+        if (word == "samples")
+            ok = tok.number(samples) && samples > 0;
+        else if (word == "v")
+            ok = hasView = readView(tok, view);
+        else if (word == "whitted" || word == "bpt" || word == "vcm")
+            renderer = word.str();
+        else
+            ok = false;
+
+        if (!ok) {
+            reply(fd, "error render syntax error");
+            return;
+        }
+    }
+
+    std::string error;
+    const auto  scene = this->scene(fname, error);
+    if (scene == nullptr) {
+        reply(fd, "error " + error);
+        return;
+    }
+
+    if (!hasView)
+        view = m_scenes[fname].view;
+    scene->camera().setup(view);
+
+    if (renderer == "bpt")
+        scene->setRenderer(new Pathtracer(*scene));
+    else if (renderer == "vcm")
+        scene->setRenderer(new VCMRenderer(*scene));
+    else
+        scene->setRenderer(new Raytracer(*scene));
+
+    scene->setSamples(samples);
+    if (endsWith(output, ".pfm"))
+        scene->attachSurface(new PfmSurface(output));
+    else if (endsWith(output, ".exr"))
+        scene->attachSurface(new ExrSurface(output));
+#ifdef HAVE_GD_SUPPORT_PNG
+    else if (endsWith(output, ".png"))
+        scene->attachSurface(new PngSurface(output));
+    else
+#endif
+        scene->attachSurface(new TgaSurface(output));
+
+    scene->setProgressCallback([fd](size_t done, size_t total) {
+        reply(fd, "progress " + std::to_string(done) + " " +
+                      std::to_string(total));
+    });
+
+    scene->run();
+    scene->detachSurfaces();
+    scene->setProgressCallback(nullptr);
+    reply(fd, "done " + output);
+}
+
+Scene* RenderServer::scene(const std::string& fname, std::string& error) {
+    const auto it = m_scenes.find(fname);
+    if (it != m_scenes.end())
+        return it->second.scene.get();
+
+    if (!MappedFile{fname}.isOpen()) {
+        error = "can not read scene " + fname;
+        return nullptr;
+    }
+
+    std::unique_ptr<Scene> scene{new Scene{}};
+    if (endsWith(fname, ".obj"))
+        scene->setSceneReader(new OBJSceneReader(fname.c_str()));
+    else
+        scene->setSceneReader(new NFFSceneReader(fname.c_str()));
+    if (m_useCache)
+        scene->setCacheFile(fname + ".cache");
+
+    scene->setRussianRoulette(m_russianRoulette);
+    scene->setPrimitiveManager(new KdTreePrimitiveManager());
+    if (!scene->init(error)) {
+        std::cerr << fname << ": " << error << std::endl;
+        return nullptr;
+    }
+
+    auto& loaded = m_scenes[fname];
+    loaded.view = scene->camera().parameters();
+    loaded.scene = std::move(scene);
+    return loaded.scene.get();
+}
@@ -2,18 +2,22 @@
 #include "scene.h"
 #include "framebuffer.h"
 #include "camera.h"
-#include "random.h"
+#include "sampler.h"
 
 Colour Renderer::render(Ray) { return {0, 0, 0}; }
 
-void Renderer::render(Framebuffer& buf, size_t) {
-    const auto& camera = m_scene.camera();
+void Renderer::render(Framebuffer& buf, size_t iter) {
+    const PhaseTimer timer{RenderStatistics::CameraPass};
+    const auto&      camera = m_scene.camera();
     for (size_t x = 0; x < buf.width(); ++x) {
         for (size_t y = 0; y < buf.height(); ++y) {
-            const auto dx = rng() - 0.5;
-            const auto dy = rng() - 0.5;
-            const auto ray = camera.spawnRay(x + dx, y + dy);
-            buf.addColour(x, y, render(ray));
+            for (size_t i = buf.samples(x, y); i > 0; --i) {
+                m_sampler->startSample(x, y, iter, i - 1);
+                const auto d = m_sampler->get2D();
+                const auto ray = camera.spawnRay(x + d.x - 0.5, y + d.y - 0.5,
+                                                 *m_sampler);
+                buf.addSample(x, y, render(ray));
+            }
         }
     }
 }
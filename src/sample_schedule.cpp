@@ -0,0 +1,82 @@
+#include "sample_schedule.h"
+
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace /* anonymous */ {
+
+/// Width and height of the tiles in pixels.
+const size_t tileSize = 16;
+
+/// Pixels are not judged from fewer samples.
+const size_t minSamples = 4;
+
+/// Upper bound of samples a pixel takes in a single pass.
+const size_t maxSamplesPerPass = 4;
+
+} // namespace anonymous
+
+SampleSchedule::SampleSchedule(size_t width, size_t height,
+                               floating threshold)
+    : m_width{width}
+    , m_height{height}
+    , m_threshold{threshold}
+    , m_samples(width * height)
+    , m_errors(width * height)
+{
+    for (auto& samples : m_samples)
+        samples.store(1, std::memory_order_relaxed);
+}
+
+size_t SampleSchedule::update(const Framebuffer (&halves)[2]) {
+    for (size_t x = 0; x < m_width; ++x) {
+        for (size_t y = 0; y < m_height; ++y) {
+            const auto stats = halves[0].unsafeGetStatistics(x, y) +
+                               halves[1].unsafeGetStatistics(x, y);
+            const auto mean = luminance(stats.mean);
+            auto&      error = m_errors[x * m_height + y];
+            if (stats.count < minSamples)
+                error = HUGE_VAL;
+            else if (mean > 0.0)
+                error = sqrt(stats.variance() / stats.count / mean);
+            else
+                error = 0.0;
+        }
+    }
+
+    size_t active = 0;
+    for (size_t x0 = 0; x0 < m_width; x0 += tileSize) {
+        for (size_t y0 = 0; y0 < m_height; y0 += tileSize) {
+            const auto x1 = std::min(x0 + tileSize, m_width);
+            const auto y1 = std::min(y0 + tileSize, m_height);
+            floating   tileError = 0.0;
+            for (size_t x = x0; x < x1; ++x)
+                for (size_t y = y0; y < y1; ++y)
+                    tileError = std::max(tileError, m_errors[x * m_height + y]);
+
+            // Every pixel of a tile that has not converged takes a sample so
+            // that a pixel does not stop on a lucky low estimate.
+            const bool converged = tileError <= m_threshold;
+            for (size_t x = x0; x < x1; ++x) {
+                for (size_t y = y0; y < y1; ++y) {
+                    const auto error = m_errors[x * m_height + y];
+                    size_t     samples = 0;
+                    if (std::isinf(error))
+                        samples = 1;
+                    else if (!converged)
+                        samples = std::min<floating>(
+                            maxSamplesPerPass,
+                            std::max(1.0, ceil(error / m_threshold)));
+
+                    m_samples[x * m_height + y].store(
+                        samples, std::memory_order_relaxed);
+                    active += samples > 0;
+                }
+            }
+        }
+    }
+
+    return active;
+}
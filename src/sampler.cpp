@@ -0,0 +1,221 @@
+#include "sampler.h"
+
+#include "random.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace /* anonymous */ {
+
+/// Number of dimensions of the Halton sequence.
+const size_t haltonDimensions = 256;
+
+const floating oneMinusEpsilon =
+    1.0 - std::numeric_limits<floating>::epsilon() / 2;
+
+uint64_t mixBits(uint64_t v) {
+    v ^= v >> 31;
+    v *= 0x7fb5d329728ea185ull;
+    v ^= v >> 27;
+    v *= 0x81dadef4bc2dd44dull;
+    v ^= v >> 33;
+    return v;
+}
+
+uint64_t hashCombine(uint64_t seed, uint64_t v) {
+    return mixBits(seed ^ (v + 0x9e3779b97f4a7c15ull + (seed << 6)));
+}
+
+uint32_t reverseBits(uint32_t x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ff) << 8) | ((x & 0xff00ff00) >> 8);
+    x = ((x & 0x0f0f0f0f) << 4) | ((x & 0xf0f0f0f0) >> 4);
+    x = ((x & 0x33333333) << 2) | ((x & 0xcccccccc) >> 2);
+    x = ((x & 0x55555555) << 1) | ((x & 0xaaaaaaaa) >> 1);
+    return x;
+}
+
+/**
+ * Owen scrambling of the bits of @a x from the most significant one down
+ * (Laine and Karras, with the constants of Burley). The first 2^k numbers are
+ * mapped to an aligned block of 2^k numbers.
+ */
+uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+    x = reverseBits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverseBits(x);
+}
+
+/**
+ * Generator matrices of the first four dimensions of the Sobol sequence. The
+ * products with every byte of the index are tabulated.
+ */
+struct SobolMatrices {
+    uint32_t bytes[4][4][256];
+
+    SobolMatrices() {
+        uint32_t v[4][32];
+        // Degree, coefficients and initial numbers of the primitive
+        // polynomials (Joe and Kuo), the first dimension is van der Corput.
+        const unsigned s[4] = {0, 1, 2, 3};
+        const unsigned a[4] = {0, 0, 1, 1};
+        const unsigned m[4][3] = {{0, 0, 0}, {1, 0, 0}, {1, 3, 0}, {1, 3, 1}};
+        for (unsigned bit = 0; bit < 32; ++bit)
+            v[0][bit] = 1u << (31 - bit);
+
+        for (unsigned d = 1; d < 4; ++d) {
+            for (unsigned bit = 0; bit < 32; ++bit) {
+                if (bit < s[d]) {
+                    v[d][bit] = m[d][bit] << (31 - bit);
+                    continue;
+                }
+
+                auto x = v[d][bit - s[d]] ^ (v[d][bit - s[d]] >> s[d]);
+                for (unsigned k = 1; k < s[d]; ++k)
+                    if ((a[d] >> (s[d] - 1 - k)) & 1)
+                        x ^= v[d][bit - k];
+                v[d][bit] = x;
+            }
+        }
+
+        for (unsigned d = 0; d < 4; ++d) {
+            for (unsigned byte = 0; byte < 4; ++byte) {
+                for (unsigned value = 0; value < 256; ++value) {
+                    uint32_t x = 0;
+                    for (unsigned bit = 0; bit < 8; ++bit)
+                        if (value & (1u << bit))
+                            x ^= v[d][8 * byte + bit];
+                    bytes[d][byte][value] = x;
+                }
+            }
+        }
+    }
+};
+
+uint32_t sobol(uint32_t index, size_t dimension) {
+    static const SobolMatrices matrices;
+    const auto& bytes = matrices.bytes[dimension];
+    return bytes[0][index & 0xff] ^ bytes[1][(index >> 8) & 0xff] ^
+           bytes[2][(index >> 16) & 0xff] ^ bytes[3][index >> 24];
+}
+
+/// Random permutations of the digits of every dimension of Halton sequence.
+class DigitPermutations {
+public: /* Methods: */
+
+    DigitPermutations() {
+        for (unsigned n = 2; m_primes.size() < haltonDimensions; ++n) {
+            const auto composite = std::any_of(
+                m_primes.begin(), m_primes.end(),
+                [n](unsigned p) { return p * p <= n && n % p == 0; });
+            if (composite)
+                continue;
+
+            // Fixed seeds keep the sequence same between runs.
+            Engine engine{n};
+            m_offsets.push_back(m_digits.size());
+            m_primes.push_back(n);
+            for (unsigned digit = 0; digit < n; ++digit)
+                m_digits.push_back(digit);
+            std::shuffle(m_digits.end() - n, m_digits.end(), engine);
+        }
+    }
+
+    unsigned base(size_t dimension) const { return m_primes[dimension]; }
+
+    const uint16_t* digits(size_t dimension) const {
+        return &m_digits[m_offsets[dimension]];
+    }
+
+private: /* Fields: */
+    std::vector<unsigned> m_primes;
+    std::vector<size_t>   m_offsets;
+    std::vector<uint16_t> m_digits;
+};
+
+/**
+ * Radical inverse of @a a with permuted digits. The infinitely many leading
+ * zero digits of @a a are permuted too, their sum is a geometric series.
+ */
+floating scrambledRadicalInverse(size_t dimension, uint32_t a) {
+    static const DigitPermutations permutations;
+    const auto     base = permutations.base(dimension);
+    const auto     perm = permutations.digits(dimension);
+    const floating invBase = 1.0 / base;
+    floating       invBaseN = 1.0;
+    uint64_t       reversed = 0;
+    while (a != 0) {
+        const auto next = a / base;
+        reversed = reversed * base + perm[a - next * base];
+        invBaseN *= invBase;
+        a = next;
+    }
+
+    const auto tail = invBase * perm[0] / (1.0 - invBase);
+    return std::min(invBaseN * (reversed + tail), oneMinusEpsilon);
+}
+
+} // namespace anonymous
+
+void Sampler::startSample(size_t x, size_t y, size_t index, size_t stream) {
+    m_index = index;
+    m_seed = hashCombine(hashCombine(hashCombine(m_renderSeed, x), y), stream);
+    m_dimension = 0;
+}
+
+void Sampler::startLightPath() {
+    m_seed = hashCombine(m_seed, 0x6c69676874ull);
+    m_dimension = 0;
+}
+
+floating RandomSampler::sample(size_t dimension) {
+    if (dimension == 0)
+        m_rng.seed(seed(), index());
+    return m_rng.uniform();
+}
+
+floating HaltonSampler::sample(size_t dimension) {
+    if (dimension >= haltonDimensions) {
+        if (dimension == haltonDimensions)
+            m_rng.seed(seed(), index());
+        return m_rng.uniform();
+    }
+
+    // Pixels are decorrelated by shifting their sequences randomly.
+    const auto shift = uint32_t(hashCombine(seed(), dimension));
+    const auto x =
+        scrambledRadicalInverse(dimension, index()) + shift / 4294967296.0;
+    return x < 1.0 ? x : x - 1.0;
+}
+
+floating PaddedSobolSampler::sample(size_t dimension) {
+    const auto d = dimension % m_groupSize;
+    if (d == 0) {
+        const auto groupSeed = hashCombine(seed(), dimension / m_groupSize);
+        const auto i = nestedUniformScramble(index(), uint32_t(groupSeed));
+        for (size_t k = 0; k < m_groupSize; ++k) {
+            const auto x = nestedUniformScramble(
+                sobol(i, k), uint32_t(hashCombine(groupSeed, k)));
+            m_group[k] = x * (1.0 / 4294967296.0);
+        }
+    }
+
+    return m_group[d];
+}
+
+Sampler* makeSampler(const std::string& name) {
+    if (name == "random")
+        return new RandomSampler{};
+    if (name == "halton")
+        return new HaltonSampler{};
+    if (name == "sobol")
+        return new SobolSampler{};
+    if (name == "pmj02")
+        return new PMJ02Sampler{};
+    return nullptr;
+}
@@ -1,20 +1,76 @@
 #include "camera.h"
+#include "checkpoint.h"
 #include "common.h"
 #include "framebuffer.h"
+#include "instance.h"
 #include "light.h"
 #include "parser.h"
 #include "primitive_manager.h"
 #include "renderer.h"
+#include "sample_schedule.h"
+#include "sampler.h"
 #include "scene.h"
+#include "scene_cache.h"
 #include "scene_reader.h"
+#include "thread_pool.h"
+#include "triangle_mesh.h"
 
 #include <boost/date_time.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/mutex.hpp>
+
+#include <atomic>
+#include <cmath>
 #include <string>
 
+namespace /* anonymous */ {
+
+/// Noise is not estimated from fewer passes in either half.
+const size_t minNoisePasses = 2;
+
+/// Surfaces are written this often while rendering.
+const auto previewInterval = boost::posix_time::seconds(10);
+
+/**
+ * Estimates the noise of the image from the even and the odd passes, which
+ * are independent estimates of it. Error of a pixel is half of the difference
+ * of their averages relative to the square root of its brightness, so that
+ * dark pixels do not dominate. Noise of the image is the mean error.
+ */
+floating estimateNoise(const Framebuffer (&halves)[2],
+                       const size_t (&passes)[2]) {
+    const auto width = halves[0].width();
+    const auto height = halves[0].height();
+    floating   sum = 0.0;
+    for (size_t x = 0; x < width; ++x) {
+        for (size_t y = 0; y < height; ++y) {
+            const auto mean = luminance(pixelColour(halves, x, y, passes));
+            if (mean > 0.0) {
+                const auto diff =
+                    luminance(pixelColour(halves[0], x, y, passes[0])) -
+                    luminance(pixelColour(halves[1], x, y, passes[1]));
+                sum += 0.5 * fabs(diff) / sqrt(mean);
+            }
+        }
+    }
+
+    return sum / (width * height);
+}
+
+} // namespace anonymous
+
 Scene::Scene()
-    : m_backgroundLight{nullptr} {
+    : m_backgroundLight{nullptr}
+    , m_sampler{new SobolSampler{}}
+    , m_seed{0}
+    , m_deterministic{false}
+    , m_checkpointInterval{0.0}
+    , m_resume{false}
+    , m_shard{0}
+    , m_shards{1}
+    , m_timeLimit{0.0}
+    , m_noiseTarget{0.0}
+    , m_adaptiveThreshold{0.0} {
     m_background = m_materials.registerMaterial(Material{Colour{0, 0, 0}});
 }
 
@@ -36,43 +92,106 @@ void Scene::setRenderer(Renderer* r) {
     m_renderer = std::unique_ptr<Renderer>(r);
 }
 
+void Scene::setSampler(Sampler* sampler) {
+    m_sampler = std::unique_ptr<Sampler>(sampler);
+}
+
+void Scene::setCheckpoint(Checkpoint* checkpoint, floating interval,
+                          bool resume) {
+    m_checkpoint = std::unique_ptr<Checkpoint>(checkpoint);
+    m_checkpointInterval = interval;
+    m_resume = resume;
+}
+
 std::string Scene::getFname() { return (*m_scene_reader).getFname(); }
 
 Scene::~Scene() {}
 
-void Scene::init() {
-    m_scene_reader->init(*this);
-    for (auto& surface : m_surfaces) {
-        surface->init();
-    }
+bool Scene::init(std::string& error) {
+    using namespace boost::posix_time;
+    const auto parse_start_time = microsec_clock::local_time();
+    std::unique_ptr<SceneCache> cache;
+    if (!m_cacheFile.empty())
+        cache.reset(new SceneCache{m_cacheFile, getFname()});
+
+    const auto cached = cache && cache->load(*this);
+    if (cached) {
+        std::cout << "Loading scene cache took "
+                  << time_period(parse_start_time,
+                                 microsec_clock::local_time())
+                         .length()
+                  << std::endl
+                  << std::endl;
+    } else {
+        if (m_scene_reader->init(*this, error) != SceneReader::OK) {
+            clear();
+            return false;
+        }
 
-    floating acc = 0.0;
-    for (auto& light : m_lights) {
-        acc += luminance(light->intensity());
+        std::cout << "Reading scene took "
+                  << time_period(parse_start_time,
+                                 microsec_clock::local_time())
+                         .length()
+                  << std::endl;
     }
 
-    if (acc > 0.0) {
-        acc = 1.0 / acc;
-        for (auto& light : m_lights) {
-            light->setSamplingPr(luminance(light->intensity()) * acc);
-        }
+    if (!cached) {
+        const auto start_time = microsec_clock::local_time();
+        m_manager->init();
+        const auto td =
+            time_period(start_time, microsec_clock::local_time()).length();
+        std::cout << "Building acceleration structure took " << td
+                  << std::endl
+                  << std::endl;
+
+        if (cache && !cache->save(*this))
+            std::cerr << "Failed to write scene cache " << m_cacheFile
+                      << std::endl;
     }
 
-    using namespace boost::posix_time;
-    const auto start_time = microsec_clock::local_time();
-    m_manager->init();
-    const auto td =
-        time_period(start_time, microsec_clock::local_time()).length();
-    std::cout << "Building acceleration structure took " << td << std::endl
-              << std::endl;
+    m_manager->setSceneSphere(m_sceneSphere);
+
+    // Power of infinite lights depends on the scene sphere.
+    m_lightSampler.build(m_lights);
+    return true;
+}
+
+void Scene::clear() {
+    m_camera = Camera{};
+    m_animation.clear();
+    m_manager->clear();
+    m_prototypes.clear();
+    m_meshes.clear();
+    m_backgroundLight = nullptr;
+    m_lights.clear();
+    m_textures.clear();
+    m_dependencies.clear();
+    m_materials.clear();
+    m_background = m_materials.registerMaterial(Material{Colour{0, 0, 0}});
+}
 
+void Scene::setTime(floating time) {
+    m_animation.apply(time, m_camera, *m_manager);
     m_manager->setSceneSphere(m_sceneSphere);
+    m_lightSampler.build(m_lights);
 }
 
 void Scene::addPrimitive(const Primitive* p) { m_manager->addPrimitive(p); }
 
+void Scene::reservePrimitives(size_t n) { m_manager->reserve(n); }
+
 void Scene::addLight(Light* l) { m_lights.emplace_back(l); }
 
+void Scene::addMesh(TriangleMesh* mesh) {
+    mesh->setIndex(m_meshes.size());
+    m_meshes.emplace_back(mesh);
+}
+
+void Scene::addPrototype(Prototype* prototype) {
+    prototype->setIndex(m_prototypes.size());
+    m_prototypes.emplace_back(prototype);
+}
+
 const std::vector<std::unique_ptr<Light>>& Scene::lights() const {
     return m_lights;
 }
@@ -89,71 +208,233 @@ Light* Scene::backgroundLight() const { return m_backgroundLight; }
 
 void Scene::run() {
     using namespace boost::posix_time;
-    const auto   start_time = microsec_clock::local_time();
-    const size_t nP = std::max(boost::thread::hardware_concurrency(), 1u);
+    const auto start_time = microsec_clock::local_time();
+    if (!m_threadPool) {
+        m_threadPool.reset(new ThreadPool{
+            std::max(boost::thread::hardware_concurrency(), 1u)});
+    }
+
+    const size_t nP = m_threadPool->size();
     std::cout << "Rendering on " << nP << " threads." << std::endl;
+    m_statistics = RenderStatistics{};
+
+    boost::mutex countMutex;
+
+    // Even and odd passes go to separate framebuffers, the image is their
+    // sum and their difference estimates the noise.
+    size_t              counts[2] = {0, 0};
+    std::atomic<size_t> nextSample{0}; ///< Index among those of the shard.
+    std::atomic<bool>   stop{false};
+    bool                done = false;
+    const auto          width = m_camera.width();
+    const auto          height = m_camera.height();
+    Framebuffer         halves[2] = {{width, height}, {width, height}};
+
+    std::unique_ptr<SampleSchedule> schedule;
+    if (m_adaptiveThreshold > 0.0)
+        schedule.reset(new SampleSchedule{width, height, m_adaptiveThreshold});
+
+    for (auto& surface : m_surfaces) {
+        surface->setDimensions(height, width);
+        surface->init();
+    }
+
+    // Criteria are checked after every pass, passes that have started are
+    // always finished.
+    const auto converged = [&](const size_t (&passes)[2]) {
+        if (m_timeLimit > 0.0 &&
+            (microsec_clock::local_time() - start_time).total_microseconds() >=
+                m_timeLimit * 1e6)
+            return true;
+
+        return m_noiseTarget > 0.0 &&
+               std::min(passes[0], passes[1]) >= minNoisePasses &&
+               estimateNoise(halves, passes) <= m_noiseTarget;
+    };
+
+    // Shard takes every m_shards-th pass starting from m_shard.
+    const size_t shardSamples =
+        m_samples > m_shard ? (m_samples - m_shard - 1) / m_shards + 1 : 0;
+
+    // Deterministic, checkpointed, noise limited and adaptive renders add the
+    // passes to the image in order and judge the criteria after each of them,
+    // passes after the one that met them are dropped. Checkpoints are saved,
+    // the noise is estimated and the samples are rescheduled between passes,
+    // while no pass is being added.
+    boost::mutex              commitMutex;
+    boost::condition_variable committed;
+    size_t                    nextCommit = 0;
+    auto                      lastCheckpoint = start_time;
+    if (m_checkpoint && m_resume && m_checkpoint->load(halves, counts)) {
+        nextCommit = counts[0] + counts[1];
+        nextSample = nextCommit;
+        std::cout << "Resuming after " << nextCommit << " samples."
+                  << std::endl;
+    }
 
-    boost::mutex        countMutex;
-    boost::thread_group threads;
-
-    size_t      count = 0;
-    bool        done = false;
-    const auto  width = m_camera.width();
-    const auto  height = m_camera.height();
-    Framebuffer frame = {width, height};
-
-    // Spawn rendering threads
-    for (size_t i = 0; i < nP; ++i) {
-        const auto renderFunc = [&, i]() {
-            auto renderer = m_renderer->clone();
-            for (size_t j = i; j < m_samples; j += nP) {
-                renderer->render(frame, j);
-                frame.flushUpdates();
+    const auto saveCheckpoint = [&]() {
+        if (!m_checkpoint->save(halves, counts)) {
+            std::cerr << "Unable to write checkpoint "
+                      << m_checkpoint->fileName() << std::endl;
+        }
+    };
+
+    // Pass j is the i-th pass of the shard.
+    const auto commitPass = [&](Framebuffer& pass, size_t i, size_t j) {
+        boost::mutex::scoped_lock lock{commitMutex};
+        while (nextCommit != i)
+            committed.wait(lock);
+
+        if (!stop) {
+            halves[j % 2].add(pass);
+            size_t passes[2];
+            {
                 boost::mutex::scoped_lock scoped_lock(countMutex);
-                ++count;
+                ++counts[j % 2];
+                passes[0] = counts[0];
+                passes[1] = counts[1];
             }
-        };
 
-        threads.create_thread(renderFunc);
-    }
+            if (converged(passes))
+                stop = true;
+
+            // Rendering is done when every pixel has converged.
+            if (schedule && schedule->update(halves) == 0)
+                stop = true;
+
+            const auto now = microsec_clock::local_time();
+            if (m_checkpoint && (now - lastCheckpoint).total_microseconds() >=
+                                    m_checkpointInterval * 1e6) {
+                saveCheckpoint();
+                lastCheckpoint = now;
+            }
+        }
+
+        ++nextCommit;
+        committed.notify_all();
+    };
+
+    const auto renderFunc = [&](size_t) {
+        threadStatistics() = RenderStatistics{};
+        auto renderer = m_renderer->clone();
+        auto sampler = m_sampler->clone();
+        sampler->setSeed(m_seed);
+        renderer->setSampler(std::move(sampler));
+        std::unique_ptr<Framebuffer> pass;
+        if (m_deterministic || m_checkpoint || m_noiseTarget > 0.0 ||
+            schedule) {
+            pass.reset(new Framebuffer{width, height});
+            pass->setSchedule(schedule.get());
+        }
+
+        for (size_t i; !stop && (i = nextSample++) < shardSamples;) {
+            const auto j = m_shard + i * m_shards;
+            if (pass) {
+                pass->clear();
+                renderer->render(*pass, j);
+                pass->flushUpdates();
+                commitPass(*pass, i, j);
+                continue;
+            }
+
+            renderer->render(halves[j % 2], j);
+            halves[j % 2].flushUpdates();
+            size_t passes[2];
+            {
+                boost::mutex::scoped_lock scoped_lock(countMutex);
+                ++counts[j % 2];
+                passes[0] = counts[0];
+                passes[1] = counts[1];
+            }
+
+            // Only the time limit applies, the noise is never estimated
+            // from passes that are still being added.
+            if (converged(passes))
+                stop = true;
+        }
+
+        boost::mutex::scoped_lock scoped_lock(countMutex);
+        m_statistics += threadStatistics();
+    };
+
+    const auto showImage = [&](const size_t (&passes)[2]) {
+        for (size_t x = 0; x < width; ++x) {
+            for (size_t y = 0; y < height; ++y)
+                updatePixel(x, y, pixelColour(halves, x, y, passes));
+        }
+    };
 
     // Spawn display thread
-    const auto displayFunc = [this, &done, &count, &countMutex, &frame]() {
+    const auto displayFunc = [&]() {
+        auto lastWrite = microsec_clock::local_time();
         while (!done) { // it's ok to use "done" in unsafe manner.
-            size_t localCount = 0;
+            size_t localCounts[2];
             {
                 boost::mutex::scoped_lock scoped_lock(countMutex);
-                localCount = count;
+                localCounts[0] = counts[0];
+                localCounts[1] = counts[1];
             }
 
-            if (localCount > 0) {
-                for (size_t x = 0; x < frame.width(); ++x) {
-                    for (size_t y = 0; y < frame.height(); ++y) {
-                        const auto c = frame.unsafeGetPixel(x, y);
-                        updatePixel(x, y, c / localCount);
-                    }
-                }
+            const auto localCount = localCounts[0] + localCounts[1];
+            if (localCount > 0)
+                showImage(localCounts);
+
+            const auto now = microsec_clock::local_time();
+            if (localCount > 0 && now - lastWrite >= previewInterval) {
+                for (auto& surface : m_surfaces)
+                    surface->write();
+                lastWrite = now;
             }
 
+            if (m_progressCallback)
+                m_progressCallback(localCount, shardSamples);
+
             boost::this_thread::sleep(boost::posix_time::seconds(1));
         }
     };
 
+    // Display thread is woken from its sleep so that back to back runs do
+    // not wait for it.
     boost::thread displayThread{displayFunc};
-    threads.join_all();
+    m_threadPool->run(renderFunc);
     done = true;
+    displayThread.interrupt();
     displayThread.join();
 
     // m_manager->debugDrawOnFramebuffer (m_camera, frame);
 
-    for (size_t x = 0; x < frame.width(); ++x) {
-        for (size_t y = 0; y < frame.height(); ++y) {
-            const auto c = frame.unsafeGetPixel(x, y);
-            updatePixel(x, y, c / count);
-        }
+    if (m_checkpoint)
+        saveCheckpoint();
+
+    const auto count = counts[0] + counts[1];
+    if (count > 0)
+        showImage(counts);
+
+    if (m_progressCallback)
+        m_progressCallback(count, shardSamples);
+
+    if (m_timeLimit > 0.0 || m_noiseTarget > 0.0 || schedule) {
+        std::cout << "Stopped after " << count << " samples";
+        if (counts[1] > 0)
+            std::cout << ", estimated noise " << estimateNoise(halves, counts);
+        std::cout << std::endl;
+    }
+
+    if (schedule) {
+        size_t total = 0;
+        for (size_t x = 0; x < width; ++x)
+            for (size_t y = 0; y < height; ++y)
+                total += (halves[0].unsafeGetStatistics(x, y) +
+                          halves[1].unsafeGetStatistics(x, y))
+                             .count;
+        std::cout << "Adaptive sampling took "
+                  << (floating)total / (width * height) << " samples per pixel"
+                  << std::endl;
     }
 
     const auto td =
         time_period(start_time, microsec_clock::local_time()).length();
     std::cout << "Took " << td << std::endl;
+    m_statistics.seconds = td.total_microseconds() * 1e-6;
+    m_statistics.print(std::cout);
 }
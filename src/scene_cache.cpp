@@ -0,0 +1,580 @@
+#include "scene_cache.h"
+
+#include "area_light.h"
+#include "background_light.h"
+#include "binary_io.h"
+#include "directional_light.h"
+#include "environment_light.h"
+#include "instance.h"
+#include "mapped_file.h"
+#include "point_light.h"
+#include "primitive_manager.h"
+#include "rectangle.h"
+#include "scene.h"
+#include "sphere.h"
+#include "spotlight.h"
+#include "surface.h"
+#include "triangle_light.h"
+#include "triangle_mesh.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <unordered_map>
+
+namespace /* anonymous */ {
+
+const uint64_t cacheMagic = 0x4548434143594152; // "RAYCACHE"
+const uint32_t cacheVersion = 8;
+
+/// Finalizer of splitmix64, every bit of @a v affects every bit of the result.
+uint64_t mixBits(uint64_t v) {
+    v ^= v >> 30;
+    v *= 0xbf58476d1ce4e5b9ull;
+    v ^= v >> 27;
+    v *= 0x94d049bb133111ebull;
+    v ^= v >> 31;
+    return v;
+}
+
+/**
+ * Hash of the bytes taken 64 bits at a time. Each word is mixed into the
+ * hash with an avalanching finalizer, so that a change anywhere in a word
+ * changes the whole hash. The tail is padded with zeroes and the length is
+ * hashed last.
+ */
+uint64_t hashBytes(const char* begin, const char* end) {
+    const uint64_t size = end - begin;
+    uint64_t       hash = 0xcbf29ce484222325;
+    for (; end - begin >= 8; begin += 8) {
+        uint64_t word;
+        memcpy(&word, begin, 8);
+        hash = mixBits(hash ^ word);
+    }
+
+    uint64_t word = 0;
+    memcpy(&word, begin, end - begin);
+    hash = mixBits(hash ^ word);
+    return mixBits(hash ^ size);
+}
+
+/// File the scene was read from besides the source, with the hash of its
+/// contents (zero if it could not be read).
+struct Dependency {
+    std::string file;
+    uint64_t    hash;
+};
+
+struct Header {
+    uint64_t                magic;
+    uint32_t                version;
+    uint64_t                sourceHash;
+    std::vector<Dependency> dependencies;
+    uint64_t                bodySize;
+    uint64_t                bodyHash;
+};
+
+void writeHeader(BinaryWriter& out, const Header& header) {
+    out.write(header.magic);
+    out.write(header.version);
+    out.write(header.sourceHash);
+    out.write<uint32_t>(header.dependencies.size());
+    for (const auto& dependency : header.dependencies) {
+        out.writeString(dependency.file);
+        out.write(dependency.hash);
+    }
+
+    out.write(header.bodySize);
+    out.write(header.bodyHash);
+}
+
+Header readHeader(BinaryReader& in) {
+    Header header{};
+    header.magic = in.read<uint64_t>();
+    header.version = in.read<uint32_t>();
+    header.sourceHash = in.read<uint64_t>();
+    // Rest of the header is laid out by the version, nothing is trusted
+    // before it is checked.
+    if (header.magic != cacheMagic || header.version != cacheVersion)
+        return header;
+
+    const auto dependencyCount = in.read<uint32_t>();
+    for (uint32_t i = 0; i < dependencyCount && in.ok(); ++i) {
+        Dependency dependency;
+        dependency.file = in.readString();
+        dependency.hash = in.read<uint64_t>();
+        header.dependencies.push_back(std::move(dependency));
+    }
+
+    header.bodySize = in.read<uint64_t>();
+    header.bodyHash = in.read<uint64_t>();
+    return header;
+}
+
+void writeMaterial(BinaryWriter& out, const Material& mat) {
+    out.writeVector(mat.colour());
+    out.write(mat.kd());
+    out.write(mat.ks());
+    out.write(mat.t());
+    out.write(mat.ior());
+    out.write(mat.phong_pow());
+}
+
+Material readMaterial(BinaryReader& in) {
+    const auto colour = in.readColour();
+    const auto kd = in.read<floating>();
+    const auto ks = in.read<floating>();
+    const auto t = in.read<floating>();
+    const auto ior = in.read<floating>();
+    const auto phongPow = in.read<floating>();
+    return Material{colour, kd, ks, t, ior, phongPow};
+}
+
+void writeTexture(BinaryWriter& out, const Texture& texture) {
+    out.write<uint32_t>(texture.width());
+    out.write<uint32_t>(texture.height());
+    for (const auto& c : texture)
+        out.writeVector(c);
+}
+
+Texture readTexture(BinaryReader& in) {
+    const auto width = in.read<uint32_t>();
+    const auto height = in.read<uint32_t>();
+    Texture    texture{width, height};
+    for (auto& c : texture)
+        c = in.readColour();
+    return texture;
+}
+
+Light* readLight(BinaryReader& in, const Scene& scene) {
+    const auto& sphere = scene.sceneSphere();
+    const auto  type = static_cast<LightType>(in.read<uint8_t>());
+    const auto  intensity = in.readColour();
+    switch (type) {
+    case LightType::Point:
+        return new PointLight{sphere, intensity, in.readPoint()};
+    case LightType::Sphere: {
+        const auto center = in.readPoint();
+        const auto radius = in.read<floating>();
+        return new SphereLight{sphere, intensity, center, radius};
+    }
+    case LightType::Area: {
+        const auto p = in.readPoint();
+        const auto u = in.readVector();
+        const auto v = in.readVector();
+        return new AreaLight{sphere, intensity, p, u, v};
+    }
+    case LightType::Triangle: {
+        const auto p0 = in.readPoint();
+        const auto p1 = in.readPoint();
+        const auto p2 = in.readPoint();
+        return new TriangleLight{sphere, intensity, p0, p1, p2};
+    }
+    case LightType::Directional:
+        return new DirectionalLight{sphere, intensity, in.readVector()};
+    case LightType::Spot: {
+        const auto pos = in.readPoint();
+        const auto dir = in.readVector();
+        const auto angle = in.read<floating>();
+        return new Spotlight{sphere, intensity, pos, dir, angle};
+    }
+    case LightType::Background:
+        return new BackgroundLight{sphere, intensity};
+    case LightType::Environment: {
+        const auto index = in.read<texture_index_t>();
+        const auto scale = in.read<floating>();
+        if (index < 0 || (size_t)index >= scene.textures().size())
+            return nullptr;
+        return new EnvironmentLight{sphere, scene.textures(), index, scale};
+    }
+    }
+
+    return nullptr;
+}
+
+Primitive* readMeshTriangle(BinaryReader& in, const Scene& scene) {
+    const auto mesh = in.read<uint32_t>();
+    uint32_t   vertices[3];
+    for (auto& vertex : vertices)
+        vertex = in.read<uint32_t>();
+    if (mesh >= scene.meshes().size())
+        return nullptr;
+
+    for (auto vertex : vertices)
+        if (vertex >= scene.meshes()[mesh]->vertexCount())
+            return nullptr;
+
+    return new MeshTriangle{*scene.meshes()[mesh], vertices[0], vertices[1],
+                            vertices[2]};
+}
+
+void writeMatrix(BinaryWriter& out, const Matrix& m) {
+    for (size_t r = 0; r < 3; ++r)
+        for (size_t c = 0; c < 4; ++c)
+            out.write(m(r, c));
+}
+
+Matrix readMatrix(BinaryReader& in) {
+    Matrix m = Matrix::identity();
+    for (size_t r = 0; r < 3; ++r)
+        for (size_t c = 0; c < 4; ++c)
+            m(r, c) = in.read<floating>();
+    return m;
+}
+
+Primitive* readInstance(BinaryReader& in, const Scene& scene) {
+    const auto prototype = in.read<uint32_t>();
+    const auto toWorld = readMatrix(in);
+    const bool overridesMaterial = in.read<uint8_t>() != 0;
+    if (prototype >= scene.prototypes().size())
+        return nullptr;
+
+    return new Instance{*scene.prototypes()[prototype], toWorld,
+                        overridesMaterial};
+}
+
+Primitive* readPrimitive(BinaryReader& in, const Scene& scene) {
+    switch (static_cast<PrimitiveType>(in.read<uint8_t>())) {
+    case PrimitiveType::Sphere: {
+        const auto center = in.readPoint();
+        const auto radius = in.read<floating>();
+        return new Sphere{center, radius};
+    }
+    case PrimitiveType::Rectangle: {
+        const auto p = in.readPoint();
+        const auto u = in.readVector();
+        const auto v = in.readVector();
+        return new Rectangle{p, u, v};
+    }
+    case PrimitiveType::MeshTriangle:
+        return readMeshTriangle(in, scene);
+    case PrimitiveType::Instance:
+        return readInstance(in, scene);
+    }
+
+    return nullptr;
+}
+
+using LightIndices = std::unordered_map<const Light*, int32_t>;
+
+/// Writes the primitive with its material, texture and light.
+void writeSurface(BinaryWriter& out, const Primitive* prim,
+                  const LightIndices& lightIndices) {
+    prim->write(out);
+    out.write(prim->material());
+    out.write(prim->texture());
+    out.write<int32_t>(prim->emissive() ? lightIndices.at(prim->getLight())
+                                        : -1);
+}
+
+/// Reads the primitive written by writeSurface(). @retval nullptr if damaged.
+Primitive* readSurface(BinaryReader& in, const Scene& scene,
+                       const std::vector<Light*>& lights) {
+    const auto prim = readPrimitive(in, scene);
+    if (prim == nullptr)
+        return nullptr;
+
+    prim->setMaterial(in.read<material_index_t>());
+    prim->setTexture(in.read<texture_index_t>());
+    const auto light = in.read<int32_t>();
+    if (light >= (int32_t)lights.size() || !in.ok()) {
+        delete prim;
+        return nullptr;
+    }
+
+    if (light >= 0)
+        prim->setLight(lights[light]);
+    return prim;
+}
+
+void writeCamera(BinaryWriter& out, const Camera::Parameters& params) {
+    out.writeVector(params.from);
+    out.writeVector(params.at);
+    out.writeVector(params.up);
+    out.write(params.fov);
+    out.write(params.hither);
+    out.write<uint32_t>(params.width);
+    out.write<uint32_t>(params.height);
+    out.write(params.aperture);
+    out.write(params.focus);
+}
+
+Camera::Parameters readCamera(BinaryReader& in) {
+    Camera::Parameters params;
+    params.from = in.readPoint();
+    params.at = in.readPoint();
+    params.up = in.readVector();
+    params.fov = in.read<floating>();
+    params.hither = in.read<floating>();
+    params.width = in.read<uint32_t>();
+    params.height = in.read<uint32_t>();
+    params.aperture = in.read<floating>();
+    params.focus = in.read<floating>();
+    return params;
+}
+
+} // anonymous namespace
+
+SceneCache::SceneCache(std::string cacheFile, std::string sourceFile)
+    : m_cacheFile{std::move(cacheFile)}
+    , m_sourceFile{std::move(sourceFile)}
+    , m_sourceHash{hashSource(m_sourceFile)}
+{}
+
+uint64_t SceneCache::hashSource(const std::string& sourceFile) {
+    const MappedFile source{sourceFile};
+    return source.isOpen() ? hashBytes(source.begin(), source.end()) : 0;
+}
+
+bool SceneCache::damaged(Scene& scene) const {
+    fprintf(stderr, "Scene cache \"%s\" is damaged, rebuilding it.\n",
+            m_cacheFile.c_str());
+    scene.clear();
+    return false;
+}
+
+bool SceneCache::load(Scene& scene) const {
+    const MappedFile file{m_cacheFile};
+    if (!file.isOpen() || m_sourceHash == 0)
+        return false;
+
+    // Everything but the contents of the scene is checked before the scene
+    // is touched so that a stale or truncated cache is simply rebuilt. A
+    // cache that turns out damaged later is rebuilt as well, the partially
+    // loaded scene is cleared first.
+    BinaryReader in{file.begin(), file.end()};
+    const auto   header = readHeader(in);
+    if (!in.ok() || header.magic != cacheMagic ||
+        header.version != cacheVersion ||
+        header.sourceHash != m_sourceHash ||
+        header.bodySize != in.remaining())
+        return false;
+
+    for (const auto& dependency : header.dependencies)
+        if (hashSource(dependency.file) != dependency.hash)
+            return false;
+
+    const auto body = file.end() - in.remaining();
+    if (hashBytes(body, file.end()) != header.bodyHash)
+        return false;
+
+    const auto params = readCamera(in);
+    scene.camera().setup(params);
+
+    auto& materials = scene.materials();
+    materials.clear();
+    const auto materialCount = in.read<uint32_t>();
+    for (uint32_t i = 0; i < materialCount; ++i)
+        materials.registerMaterial(readMaterial(in));
+    scene.m_background = in.read<material_index_t>();
+    if (scene.m_background >= materials.size())
+        return damaged(scene);
+
+    const auto textureCount = in.read<uint32_t>();
+    for (uint32_t i = 0; i < textureCount; ++i)
+        scene.textures().registerTexture(readTexture(in));
+
+    std::vector<Light*> lights(in.read<uint32_t>());
+    for (auto& light : lights) {
+        light = readLight(in, scene);
+        if (light == nullptr)
+            return damaged(scene);
+        scene.addLight(light);
+    }
+
+    const auto backgroundLight = in.read<int32_t>();
+    if (backgroundLight >= (int32_t)lights.size())
+        return damaged(scene);
+    if (backgroundLight >= 0)
+        scene.setBackgroundLight(lights[backgroundLight]);
+
+    const auto meshCount = in.read<uint32_t>();
+    for (uint32_t i = 0; i < meshCount; ++i) {
+        const bool hasNormals = in.read<uint8_t>() != 0;
+        const bool hasUVs = in.read<uint8_t>() != 0;
+        auto       mesh = new TriangleMesh{hasNormals, hasUVs};
+        scene.addMesh(mesh);
+        if (!mesh->read(in))
+            return damaged(scene);
+    }
+
+    // Prototype is added to the scene once read so that instances can only
+    // refer to the prototypes before them.
+    const auto prototypeCount = in.read<uint32_t>();
+    for (uint32_t i = 0; i < prototypeCount; ++i) {
+        std::unique_ptr<Prototype> prototype{new Prototype{}};
+        const auto primCount = in.read<uint32_t>();
+        for (uint32_t j = 0; j < primCount; ++j) {
+            const auto prim = readSurface(in, scene, lights);
+            if (prim == nullptr)
+                return damaged(scene);
+            prototype->addPrimitive(prim);
+        }
+
+        if (prototype->empty() || !prototype->manager().read(in))
+            return damaged(scene);
+        scene.addPrototype(prototype.release());
+    }
+
+    const auto primCount = in.read<uint32_t>();
+    scene.reservePrimitives(primCount);
+    std::vector<Primitive*> prims;
+    prims.reserve(primCount);
+    for (uint32_t i = 0; i < primCount; ++i) {
+        const auto prim = readSurface(in, scene, lights);
+        if (prim == nullptr)
+            return damaged(scene);
+        scene.addPrimitive(prim);
+        prims.push_back(prim);
+    }
+
+    if (!scene.manager().read(in))
+        return damaged(scene);
+
+    auto&      animation = scene.animation();
+    const auto cameraKeyCount = in.read<uint32_t>();
+    for (uint32_t i = 0; i < cameraKeyCount; ++i) {
+        Animation::CameraKey key;
+        key.time = in.read<floating>();
+        key.from = in.readPoint();
+        key.at = in.readPoint();
+        key.up = in.readVector();
+        key.fov = in.read<floating>();
+        animation.addCameraKey(key);
+    }
+
+    const auto trackCount = in.read<uint32_t>();
+    for (uint32_t i = 0; i < trackCount; ++i) {
+        const auto index = in.read<uint32_t>();
+        const auto instance = index < prims.size()
+                                  ? dynamic_cast<Instance*>(prims[index])
+                                  : nullptr;
+        const auto keyCount = in.read<uint32_t>();
+        if (instance == nullptr || keyCount == 0)
+            return damaged(scene);
+        for (uint32_t j = 0; j < keyCount; ++j) {
+            const auto time = in.read<floating>();
+            const auto toWorld = readMatrix(in);
+            animation.addInstanceKey(instance,
+                                     Animation::InstanceKey{time, toWorld});
+        }
+    }
+
+    if (!in.ok())
+        return damaged(scene);
+
+    for (const auto& dependency : header.dependencies)
+        scene.addDependency(dependency.file);
+    return true;
+}
+
+bool SceneCache::save(const Scene& scene) const {
+    if (m_sourceHash == 0)
+        return false;
+
+    BinaryWriter out;
+    writeCamera(out, scene.camera().parameters());
+
+    const auto& materials = scene.materials();
+    out.write<uint32_t>(materials.size() - 1);
+    for (size_t i = 1; i < materials.size(); ++i)
+        writeMaterial(out, materials[i]);
+    out.write(scene.m_background);
+
+    const auto& textures = scene.textures();
+    out.write<uint32_t>(textures.size());
+    for (size_t i = 0; i < textures.size(); ++i)
+        writeTexture(out, *textures[i]);
+
+    LightIndices lightIndices;
+    out.write<uint32_t>(scene.lights().size());
+    for (const auto& light : scene.lights()) {
+        lightIndices.emplace(light.get(), (int32_t)lightIndices.size());
+        light->write(out);
+    }
+
+    const auto backgroundLight = scene.backgroundLight();
+    out.write<int32_t>(backgroundLight != nullptr
+                           ? lightIndices.at(backgroundLight)
+                           : -1);
+
+    out.write<uint32_t>(scene.meshes().size());
+    for (const auto& mesh : scene.meshes()) {
+        out.write<uint8_t>(mesh->hasNormals());
+        out.write<uint8_t>(mesh->hasUVs());
+        mesh->write(out);
+    }
+
+    out.write<uint32_t>(scene.prototypes().size());
+    for (const auto& prototype : scene.prototypes()) {
+        const auto& prims = prototype->manager().primitives();
+        out.write<uint32_t>(prims.size());
+        for (const auto prim : prims)
+            writeSurface(out, prim, lightIndices);
+        prototype->manager().write(out);
+    }
+
+    const auto& prims = scene.manager().primitives();
+    out.write<uint32_t>(prims.size());
+    for (const auto prim : prims)
+        writeSurface(out, prim, lightIndices);
+
+    scene.manager().write(out);
+
+    const auto& animation = scene.animation();
+    out.write<uint32_t>(animation.cameraKeys().size());
+    for (const auto& key : animation.cameraKeys()) {
+        out.write(key.time);
+        out.writeVector(key.from);
+        out.writeVector(key.at);
+        out.writeVector(key.up);
+        out.write(key.fov);
+    }
+
+    // Tracks refer to the instances by their position among the primitives.
+    std::unordered_map<const Primitive*, uint32_t> primIndices;
+    if (!animation.tracks().empty())
+        for (const auto prim : prims)
+            primIndices.emplace(prim, (uint32_t)primIndices.size());
+
+    out.write<uint32_t>(animation.tracks().size());
+    for (const auto& track : animation.tracks()) {
+        out.write(primIndices.at(track.instance));
+        out.write<uint32_t>(track.keys.size());
+        for (const auto& key : track.keys) {
+            out.write(key.time);
+            writeMatrix(out, key.toWorld);
+        }
+    }
+
+    const auto&  body = out.buffer();
+    const auto   bodyHash = hashBytes(body.data(), body.data() + body.size());
+    std::vector<Dependency> dependencies;
+    for (const auto& file : scene.dependencies())
+        dependencies.push_back(Dependency{file, hashSource(file)});
+
+    BinaryWriter header;
+    writeHeader(header, Header{cacheMagic, cacheVersion, m_sourceHash,
+                               std::move(dependencies), body.size(),
+                               bodyHash});
+
+    // Written under a temporary name so that an interrupted write never
+    // leaves a truncated cache behind.
+    const auto tmpFile = m_cacheFile + ".tmp";
+    FILE*      fptr = fopen(tmpFile.c_str(), "wb");
+    if (fptr == nullptr)
+        return false;
+
+    const auto& head = header.buffer();
+    const bool  ok = fwrite(head.data(), 1, head.size(), fptr) == head.size() &&
+                    fwrite(body.data(), 1, body.size(), fptr) == body.size();
+    if (fclose(fptr) != 0 || !ok ||
+        rename(tmpFile.c_str(), m_cacheFile.c_str()) != 0) {
+        remove(tmpFile.c_str());
+        return false;
+    }
+
+    return true;
+}
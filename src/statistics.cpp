@@ -0,0 +1,178 @@
+#include "statistics.h"
+
+#include <iostream>
+
+#ifndef HAVE_THREAD_LOCAL_STORAGE
+  #include <boost/thread/tss.hpp>
+#endif
+
+namespace /* anonymous */ {
+
+const char* const rayTypeNames[RenderStatistics::NumRayTypes] = {
+    "camera", "light", "shadow", "connection"};
+
+const char* const phaseNames[RenderStatistics::NumPhases] = {
+    "light_pass", "grid_build", "camera_pass"};
+
+size_t sum(const size_t (&counts)[RenderStatistics::NumPathLengths]) {
+    size_t total = 0;
+    for (auto count : counts)
+        total += count;
+    return total;
+}
+
+void printPathLengths(std::ostream& os, const char* name,
+                      const size_t (&counts)[RenderStatistics::NumPathLengths],
+                      size_t segments) {
+    const auto paths = sum(counts);
+    if (paths == 0)
+        return;
+
+    os << "Average " << name << " path length " << (floating)segments / paths
+       << " (" << paths << " paths):";
+    for (size_t i = 0; i < RenderStatistics::NumPathLengths; ++i) {
+        const auto last = i + 1 == RenderStatistics::NumPathLengths;
+        if (counts[i] > 0)
+            os << ' ' << i << (last ? "+" : "") << '=' << counts[i];
+    }
+
+    os << std::endl;
+}
+
+void writeJsonPaths(std::ostream& os,
+                    const size_t (&counts)[RenderStatistics::NumPathLengths],
+                    size_t segments) {
+    os << "{\"count\": " << sum(counts) << ", \"segments\": " << segments
+       << ", \"histogram\": [";
+    for (size_t i = 0; i < RenderStatistics::NumPathLengths; ++i)
+        os << (i > 0 ? ", " : "") << counts[i];
+    os << "]}";
+}
+
+} // namespace anonymous
+
+RenderStatistics::RenderStatistics()
+    : rays{}
+    , nodesVisited{0}
+    , primitivesTested{0}
+    , gridQueries{0}
+    , gridProbes{0}
+    , flushes{0}
+    , flushedUpdates{0}
+    , eyePathLengths{}
+    , lightPathLengths{}
+    , eyeSegments{0}
+    , lightSegments{0}
+    , phaseSeconds{}
+    , seconds{0.0}
+{}
+
+size_t RenderStatistics::totalRays() const {
+    size_t total = 0;
+    for (auto count : rays)
+        total += count;
+    return total;
+}
+
+size_t RenderStatistics::eyePaths() const { return sum(eyePathLengths); }
+
+size_t RenderStatistics::lightPaths() const { return sum(lightPathLengths); }
+
+floating RenderStatistics::mraysPerSecond() const {
+    return seconds > 0.0 ? totalRays() / seconds * 1e-6 : 0.0;
+}
+
+RenderStatistics& RenderStatistics::operator+=(const RenderStatistics& other) {
+    for (size_t i = 0; i < NumRayTypes; ++i)
+        rays[i] += other.rays[i];
+    nodesVisited += other.nodesVisited;
+    primitivesTested += other.primitivesTested;
+    gridQueries += other.gridQueries;
+    gridProbes += other.gridProbes;
+    flushes += other.flushes;
+    flushedUpdates += other.flushedUpdates;
+    for (size_t i = 0; i < NumPathLengths; ++i) {
+        eyePathLengths[i] += other.eyePathLengths[i];
+        lightPathLengths[i] += other.lightPathLengths[i];
+    }
+
+    eyeSegments += other.eyeSegments;
+    lightSegments += other.lightSegments;
+    for (size_t i = 0; i < NumPhases; ++i)
+        phaseSeconds[i] += other.phaseSeconds[i];
+    seconds += other.seconds;
+    return *this;
+}
+
+void RenderStatistics::print(std::ostream& os) const {
+    const auto total = totalRays();
+    if (total > 0) {
+        os << "Traced " << total << " rays (";
+        for (size_t i = 0; i < NumRayTypes; ++i)
+            os << (i > 0 ? ", " : "") << rays[i] << ' ' << rayTypeNames[i];
+        os << "), " << mraysPerSecond() << " Mrays/s" << std::endl;
+        os << "Per ray " << (floating)nodesVisited / total
+           << " kd-tree nodes visited, " << (floating)primitivesTested / total
+           << " primitives tested" << std::endl;
+    }
+
+    if (gridQueries > 0) {
+        os << "Hash grid queries " << gridQueries << ", "
+           << (floating)gridProbes / gridQueries << " vertices tested per query"
+           << std::endl;
+    }
+
+    if (flushes > 0) {
+        os << "Framebuffer flushes " << flushes << ", "
+           << (floating)flushedUpdates / flushes << " updates per flush"
+           << std::endl;
+    }
+
+    printPathLengths(os, "eye", eyePathLengths, eyeSegments);
+    printPathLengths(os, "light", lightPathLengths, lightSegments);
+
+    if (phaseSeconds[LightPass] > 0.0 || phaseSeconds[GridBuild] > 0.0) {
+        os << "Thread time in";
+        for (size_t i = 0; i < NumPhases; ++i)
+            os << (i > 0 ? ", " : " ") << phaseNames[i] << ' '
+               << phaseSeconds[i] << 's';
+        os << std::endl;
+    }
+}
+
+void RenderStatistics::writeJson(std::ostream& os) const {
+    os << "{\n  \"seconds\": " << seconds << ",\n  \"rays\": {";
+    for (size_t i = 0; i < NumRayTypes; ++i)
+        os << '"' << rayTypeNames[i] << "\": " << rays[i] << ", ";
+    os << "\"total\": " << totalRays() << "},\n"
+       << "  \"mrays_per_second\": " << mraysPerSecond() << ",\n"
+       << "  \"kdtree\": {\"nodes_visited\": " << nodesVisited
+       << ", \"primitives_tested\": " << primitivesTested << "},\n"
+       << "  \"hash_grid\": {\"queries\": " << gridQueries
+       << ", \"probes\": " << gridProbes << "},\n"
+       << "  \"framebuffer\": {\"flushes\": " << flushes
+       << ", \"updates\": " << flushedUpdates << "},\n"
+       << "  \"eye_paths\": ";
+    writeJsonPaths(os, eyePathLengths, eyeSegments);
+    os << ",\n  \"light_paths\": ";
+    writeJsonPaths(os, lightPathLengths, lightSegments);
+    os << ",\n  \"phase_seconds\": {";
+    for (size_t i = 0; i < NumPhases; ++i)
+        os << (i > 0 ? ", " : "") << '"' << phaseNames[i]
+           << "\": " << phaseSeconds[i];
+    os << "}\n}\n";
+}
+
+RenderStatistics& threadStatistics() {
+#ifdef HAVE_THREAD_LOCAL_STORAGE
+    static thread_local RenderStatistics statistics;
+    return statistics;
+#else
+    static boost::thread_specific_ptr<RenderStatistics> statistics_ptr;
+    if (!statistics_ptr.get()) {
+        statistics_ptr.reset(new RenderStatistics{});
+    }
+
+    return *statistics_ptr;
+#endif
+}
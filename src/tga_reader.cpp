@@ -55,13 +55,21 @@ void MergeBytes(PIXEL* pixel, unsigned char* p, size_t bytes) {
     }
 }
 
+/// Releases the file and the pixels of a texture that can not be read.
+Texture failed(FILE* fptr, PIXEL* pixels) {
+    free(pixels);
+    fclose(fptr);
+    return Texture(0, 0);
+}
+
 } // anonymous namespace
 
 Texture readTexture(std::string tgaFileName) {
     FILE* fptr;
     if ((fptr = fopen(tgaFileName.c_str(), "r")) == NULL) {
-        printf("Failed to open texture file\n");
-        exit(-1);
+        fprintf(stderr, "Failed to open texture file \"%s\"\n",
+                tgaFileName.c_str());
+        return Texture(0, 0);
     }
 
     HEADER        header;
@@ -76,8 +84,9 @@ Texture readTexture(std::string tgaFileName) {
 
     if ((pixels = (PIXEL*)malloc(header.width * header.height *
                                  sizeof(PIXEL))) == NULL) {
-        printf("malloc of image failed\n");
-        exit(-1);
+        fprintf(stderr, "malloc of image failed\n");
+        fclose(fptr);
+        return Texture(0, 0);
     }
     for (i = 0; i < header.width * header.height; i++) {
         pixels[i].r = 0;
@@ -88,8 +97,8 @@ Texture readTexture(std::string tgaFileName) {
 
     /* What can we handle */
     if (header.datatypecode != 2 && header.datatypecode != 10) {
-        printf("Can only handle image type 2 and 10\n");
-        exit(-1);
+        fprintf(stderr, "Can only handle image type 2 and 10\n");
+        return failed(fptr, pixels);
     }
     /*if (header.bitsperpixel != 16 &&
         header.bitsperpixel != 24 && header.bitsperpixel != 32) {
@@ -97,12 +106,12 @@ Texture readTexture(std::string tgaFileName) {
         exit(-1);
     }*/
     if (header.bitsperpixel != 24) {
-        printf("Can only handle pixel depths of 24\n");
-        exit(-1);
+        fprintf(stderr, "Can only handle pixel depths of 24\n");
+        return failed(fptr, pixels);
     }
     if (header.colourmaptype != 0 && header.colourmaptype != 1) {
-        printf("Can only handle colour map types of 0 and 1\n");
-        exit(-1);
+        fprintf(stderr, "Can only handle colour map types of 0 and 1\n");
+        return failed(fptr, pixels);
     }
 
     /* Skip over unnecessary stuff */
@@ -115,15 +124,15 @@ Texture readTexture(std::string tgaFileName) {
     while (n < header.width * header.height) {
         if (header.datatypecode == 2) { /* Uncompressed */
             if (fread(p, 1, bytes2read, fptr) != bytes2read) {
-                printf("Unexpected end of file at pixel %d\n", i);
-                exit(-1);
+                fprintf(stderr, "Unexpected end of file at pixel %d\n", i);
+                return failed(fptr, pixels);
             }
             MergeBytes(&(pixels[n]), p, bytes2read);
             n++;
         } else if (header.datatypecode == 10) { /* Compressed */
             if (fread(p, 1, bytes2read + 1, fptr) != bytes2read + 1) {
-                printf("Unexpected end of file at pixel %d\n", i);
-                exit(-1);
+                fprintf(stderr, "Unexpected end of file at pixel %d\n", i);
+                return failed(fptr, pixels);
             }
             j = p[0] & 0x7f;
             MergeBytes(&(pixels[n]), &(p[1]), bytes2read);
@@ -136,8 +145,9 @@ Texture readTexture(std::string tgaFileName) {
             } else { /* Normal chunk */
                 for (i = 0; i < j; i++) {
                     if (fread(p, 1, bytes2read, fptr) != bytes2read) {
-                        printf("Unexpected end of file at pixel %d\n", i);
-                        exit(-1);
+                        fprintf(stderr,
+                                "Unexpected end of file at pixel %d\n", i);
+                        return failed(fptr, pixels);
                     }
                     MergeBytes(&(pixels[n]), p, bytes2read);
                     n++;
@@ -34,7 +34,14 @@ void TgaSurface::init() {
 
 TgaSurface::~TgaSurface() {
     const PixelDtor pixel_dtor{data, (size_t)m_height};
-    FILE*           out = fopen(m_fname.c_str(), "wb");
+    write();
+}
+
+void TgaSurface::write() {
+    if (data == nullptr)
+        return;
+
+    FILE* out = fopen(m_fname.c_str(), "wb");
     std::unique_ptr<FILE, int (*)(FILE*)> file_closer = {out, &fclose};
 
     if (out == nullptr) {
@@ -0,0 +1,84 @@
+#include "triangle_mesh.h"
+
+#include <cassert>
+#include <utility>
+
+size_t TriangleMesh::VertexKeyHash::operator()(const VertexKey& key) const {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (auto value : key.values) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        hash = (hash ^ bits) * 0x100000001b3;
+    }
+
+    return (size_t)(hash ^ (hash >> 32));
+}
+
+uint32_t TriangleMesh::addVertex(Point pos, Vector normal, Vector2 uv) {
+    if (!m_hasNormals)
+        normal = Vector{0, 0, 0};
+    if (!m_hasUVs)
+        uv = Vector2{0, 0};
+
+    const auto key = VertexKey{{pos.x, pos.y, pos.z, normal.x, normal.y,
+                                normal.z, uv.x, uv.y}};
+    const auto index = (uint32_t)m_positions.size();
+    const auto inserted = m_lookup.emplace(key, index);
+    if (!inserted.second)
+        return inserted.first->second;
+
+    m_positions.push_back(pos);
+    if (m_hasNormals)
+        m_normals.push_back(normal);
+    if (m_hasUVs)
+        m_uvs.push_back(uv);
+    return index;
+}
+
+void TriangleMesh::assign(std::vector<Point> positions,
+                          std::vector<Vector> normals,
+                          std::vector<Vector2> uvs) {
+    assert(!m_hasNormals || normals.size() == positions.size());
+    assert(!m_hasUVs || uvs.size() == positions.size());
+    Lookup().swap(m_lookup);
+    m_positions = std::move(positions);
+    m_normals = m_hasNormals ? std::move(normals) : std::vector<Vector>{};
+    m_uvs = m_hasUVs ? std::move(uvs) : std::vector<Vector2>{};
+}
+
+void TriangleMesh::finish() {
+    Lookup().swap(m_lookup);
+    m_positions.shrink_to_fit();
+    m_normals.shrink_to_fit();
+    m_uvs.shrink_to_fit();
+}
+
+void TriangleMesh::write(BinaryWriter& out) const {
+    out.write<uint32_t>(m_positions.size());
+    for (size_t i = 0; i < m_positions.size(); ++i) {
+        out.writeVector(m_positions[i]);
+        if (m_hasNormals)
+            out.writeVector(m_normals[i]);
+        if (m_hasUVs) {
+            out.write(m_uvs[i].x);
+            out.write(m_uvs[i].y);
+        }
+    }
+}
+
+bool TriangleMesh::read(BinaryReader& in) {
+    const auto vertexCount = in.read<uint32_t>();
+    m_positions.reserve(vertexCount);
+    for (uint32_t i = 0; i < vertexCount && in.ok(); ++i) {
+        m_positions.push_back(in.readPoint());
+        if (m_hasNormals)
+            m_normals.push_back(in.readVector());
+        if (m_hasUVs) {
+            const auto u = in.read<floating>();
+            const auto v = in.read<floating>();
+            m_uvs.push_back(Vector2{u, v});
+        }
+    }
+
+    return in.ok();
+}